@@ -0,0 +1,344 @@
+#include <serializer/json/impl.h>
+#include <serializer/json/binary.h>
+#include <serializer/json/fields.h>
+#include <serializer/msgpack/value.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace json;
+
+struct Meta {
+  double created = 0;
+  bool active = false;
+};
+
+SERIALIZER_FIELDS(Meta, created, active)
+
+struct Record {
+  int id = 0;
+  std::string name;
+  std::vector<std::string> tags;
+  Meta meta;
+};
+
+SERIALIZER_FIELDS(Record, id, name, tags, meta)
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ns(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// equivalent(Object, Object) as it used to be: every key of one side searched for on the other
+bool nested_loop_equivalent(const Object& v1, const Object& v2) {
+  if (v1.size() != v2.size())
+    return false;
+
+  for (const auto& p1 : v1) {
+    bool key_match = false;
+    for (const auto& p2 : v2) {
+      if (p1.first == p2.first) {
+        key_match = true;
+        if (!equivalent(p1.second, p2.second))
+          return false;
+        break;
+      }
+    }
+    if (!key_match)
+      return false;
+  }
+
+  return true;
+}
+
+// two equal objects of n members, listed in opposite orders
+void make_objects(std::size_t n, Object& forward, Object& backward) {
+  for (std::size_t i = 0; i < n; ++i) {
+    forward["key" + std::to_string(i)] = static_cast<Number>(i);
+    backward["key" + std::to_string(n - 1 - i)] = static_cast<Number>(n - 1 - i);
+  }
+}
+
+template <typename Compare>
+double time_per_member(std::size_t n, const Object& v1, const Object& v2, Compare compare) {
+  std::size_t reps = std::max<std::size_t>(1000000 / n, 1);
+  if (n > 10000)
+    reps = 1;
+
+  bool same = true;
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < reps; ++i)
+    same = compare(v1, v2) && same;
+  auto res = elapsed_ns(start) / static_cast<double>(reps * n);
+  if (!same)
+    std::cerr << "mismatch" << std::endl;
+  return res;
+}
+
+// the cost per member stays flat as objects grow, where the nested loop grows linearly
+void object_equality() {
+  std::cout << "object equality, ns per member (members in opposite order)" << std::endl;
+  std::cout << std::setw(10) << "members" << std::setw(14) << "equivalent" << std::setw(14) << "nested loop" << std::endl;
+  for (std::size_t n : {10, 100, 1000, 10000, 100000}) {
+    Object v1, v2;
+    make_objects(n, v1, v2);
+
+    std::cout << std::setw(10) << n << std::setw(14) << std::fixed << std::setprecision(1)
+              << time_per_member(n, v1, v2, [](const Object& a, const Object& b) { return equivalent(a, b); });
+    if (n <= 10000)
+      std::cout << std::setw(14) << time_per_member(n, v1, v2, nested_loop_equivalent);
+    std::cout << std::endl;
+  }
+}
+
+// a document shaped like a large api response: many records of a few members each
+void document_equality() {
+  Array records;
+  for (int i = 0; i < 200000; ++i) {
+    records.push_back(Object{
+      {"id", i},
+      {"name", "record " + std::to_string(i)},
+      {"tags", Array{"a", "b", i % 13}},
+      {"meta", Object{{"created", 1500000000 + i}, {"active", i % 2 == 0}}}
+    });
+  }
+  Value v1 = Object{{"records", records}};
+  Value v2 = v1.deep_clone();
+
+  auto start = Clock::now();
+  auto same = equivalent(v1, v2);
+  auto serial = elapsed_ns(start) / 1e6;
+
+  start = Clock::now();
+  same = parallel_equivalent(v1, v2) && same;
+  auto parallel = elapsed_ns(start) / 1e6;
+
+  std::cout << "document equality, 200000 records: equivalent " << serial << "ms, parallel_equivalent "
+            << parallel << "ms (" << std::thread::hardware_concurrency() << " threads)" << (same ? "" : " mismatch") << std::endl;
+}
+
+// hashing serialized text against structural hashes, which are cached per node
+void document_hash() {
+  Array records;
+  for (int i = 0; i < 200000; ++i)
+    records.push_back(Object{{"id", i}, {"name", "record " + std::to_string(i)}, {"tags", Array{"a", "b", i % 13}}});
+  Value doc = Object{{"records", records}};
+
+  auto start = Clock::now();
+  std::hash<std::string>()(doc.json());
+  auto serialized = elapsed_ns(start) / 1e6;
+
+  start = Clock::now();
+  auto first = hash(doc);
+  auto cold = elapsed_ns(start) / 1e6;
+
+  doc["records"][123456]["name"] = "edited";
+  start = Clock::now();
+  auto edited = hash(doc);
+  auto warm = elapsed_ns(start) / 1e6;
+
+  std::cout << "document hash, 200000 records: json() text " << serialized << "ms, hash " << cold
+            << "ms, hash after one edit " << warm << "ms" << (first != edited ? "" : " unchanged") << std::endl;
+}
+
+// filling in a few fields of a large template document per request
+void template_edit() {
+  Array records;
+  for (int i = 0; i < 100000; ++i)
+    records.push_back(Object{{"id", i}, {"name", "record " + std::to_string(i)}});
+  Value tmpl = Object{{"header", Object{{"request", nullptr}, {"user", nullptr}}}, {"records", records}};
+
+  const int requests = 100;
+  auto start = Clock::now();
+  for (int i = 0; i < requests; ++i) {
+    Value res = tmpl.clone();
+    res["header"]["request"] = i;
+    res["header"]["user"] = "someone";
+  }
+  auto cloned = elapsed_ns(start) / 1e3 / requests;
+
+  start = Clock::now();
+  for (int i = 0; i < requests; ++i) {
+    Value res = tmpl.deep_clone();
+    res["header"]["request"] = i;
+    res["header"]["user"] = "someone";
+  }
+  auto copied = elapsed_ns(start) / 1e3 / requests;
+
+  std::cout << "template edit, 100000 records: clone " << cloned << "us, deep_clone " << copied << "us per request" << std::endl;
+}
+
+// building and parsing large arrays, where every element should be moved rather than copied
+void array_building() {
+  const int count = 1000000;
+
+  auto start = Clock::now();
+  Array arr;
+  for (int i = 0; i < count; ++i)
+    arr.push_back(Value::make_object("id", i, "name", "record " + std::to_string(i)));
+  auto build = elapsed_ns(start) / 1e6;
+
+  start = Clock::now();
+  Value doc(std::move(arr));
+  auto wrap = elapsed_ns(start) / 1e6;
+
+  auto text = doc.json();
+  start = Clock::now();
+  Value parsed;
+  parsed.parse(text);
+  auto parse = elapsed_ns(start) / 1e6;
+
+  std::cout << "array building, " << count << " objects: push_back " << build << "ms, into a Value " << wrap
+            << "ms, parse " << parse << "ms" << std::endl;
+}
+
+// the fastest of a few runs in ms, leaving out the cost of first touching fresh memory
+template <typename Work>
+double best_of(int runs, Work work) {
+  double best = 0;
+  for (int i = 0; i < runs; ++i) {
+    auto start = Clock::now();
+    work();
+    auto res = elapsed_ns(start) / 1e6;
+    if (i == 0 || res < best)
+      best = res;
+  }
+  return best;
+}
+
+// the same document as json text and as MessagePack
+void msgpack_encoding() {
+  Array records;
+  for (int i = 0; i < 200000; ++i) {
+    records.push_back(Value::make_object(
+      "id", i,
+      "name", "record " + std::to_string(i),
+      "score", i * 0.25,
+      "tags", Value::make_array("a", "b", i % 13),
+      "active", i % 2 == 0
+    ));
+  }
+  Value doc = Object{{"records", std::move(records)}};
+
+  std::string text, bytes;
+  auto json_write = best_of(3, [&] { text = doc.json(); });
+  auto msgpack_write = best_of(3, [&] {
+    bytes.clear();
+    msgpack::OutStream out(bytes);
+    format(out, doc);
+  });
+
+  Value from_text, from_bytes;
+  auto json_read = best_of(3, [&] { from_text.parse(text); });
+  auto msgpack_read = best_of(3, [&] {
+    msgpack::InStream in(bytes);
+    format(in, from_bytes);
+  });
+
+  std::cout << "msgpack, 200000 records: json " << text.size() / 1024 << "KB written in " << json_write << "ms, read in "
+            << json_read << "ms; msgpack " << bytes.size() / 1024 << "KB written in " << msgpack_write << "ms, read in "
+            << msgpack_read << "ms" << (equivalent(from_text, from_bytes) ? "" : " mismatch") << std::endl;
+}
+
+// opening a dataset from a file and reading one record, from json text and from the binary format
+void binary_loading() {
+  Array records;
+  for (int i = 0; i < 200000; ++i) {
+    records.push_back(Value::make_object(
+      "id", i,
+      "name", "record " + std::to_string(i),
+      "tags", Value::make_array("a", "b", i % 13),
+      "meta", Value::make_object("created", 1500000000 + i, "active", i % 2 == 0)
+    ));
+  }
+  Value doc = Object{{"records", std::move(records)}};
+
+  auto text = doc.json();
+  auto bytes = to_binary(doc);
+  std::ofstream("bench_dataset.json", std::ios::binary) << text;
+  std::ofstream("bench_dataset.jsonb", std::ios::binary) << bytes;
+
+  Number found = 0;
+  auto json_open = best_of(3, [&] {
+    Value val;
+    val.parse_file("bench_dataset.json");
+    found += val["records"][123456]["meta"]["created"].as<Number>();
+  });
+  auto binary_open = best_of(3, [&] {
+    BinaryDocument bin;
+    bin.open("bench_dataset.jsonb");
+    found += bin.root()["records"][123456]["meta"]["created"].as<Number>();
+  });
+
+  BinaryDocument bin;
+  bin.open("bench_dataset.jsonb");
+  auto convert = best_of(3, [&] { bin.root().to_value(); });
+  std::remove("bench_dataset.json");
+  std::remove("bench_dataset.jsonb");
+
+  std::cout << "binary loading, 200000 records: json " << text.size() / 1024 << "KB opened in " << json_open
+            << "ms; binary " << bytes.size() / 1024 << "KB opened in " << binary_open * 1000 << "us, to_value "
+            << convert << "ms" << (found == 6 * 1500123456.0 ? "" : " mismatch") << std::endl;
+}
+
+// reading records into structs directly, against parsing a Value and copying the fields out
+void struct_mapping() {
+  std::vector<Record> records(200000);
+  for (int i = 0; i < 200000; ++i) {
+    records[i].id = i;
+    records[i].name = "record " + std::to_string(i);
+    records[i].tags = {"a", "b"};
+    records[i].meta.created = 1500000000 + i;
+    records[i].meta.active = i % 2 == 0;
+  }
+
+  std::string text;
+  auto write = best_of(3, [&] {
+    text.clear();
+    OutStream out(text);
+    format(out, records);
+  });
+
+  std::vector<Record> read;
+  auto mapped = best_of(3, [&] {
+    read.clear();
+    InStream in(text);
+    format(in, read);
+  });
+
+  std::vector<Record> copied;
+  auto through_value = best_of(3, [&] {
+    copied.clear();
+    Value val;
+    val.parse(text);
+    for (const auto& item : val.as<Array>()) {
+      Record rec;
+      rec.id = static_cast<int>(item["id"].as<Number>());
+      rec.name = item["name"].as<String>();
+      for (const auto& tag : item["tags"].as<Array>())
+        rec.tags.push_back(tag.as<String>());
+      rec.meta.created = item["meta"]["created"].as<Number>();
+      rec.meta.active = item["meta"]["active"].as<Bool>();
+      copied.push_back(std::move(rec));
+    }
+  });
+
+  std::cout << "struct mapping, 200000 records: write " << write << "ms, read " << mapped << "ms, through a Value "
+            << through_value << "ms" << (read.size() == copied.size() && read[123456].name == copied[123456].name ? "" : " mismatch") << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  object_equality();
+  document_equality();
+  document_hash();
+  template_edit();
+  array_building();
+  msgpack_encoding();
+  binary_loading();
+  struct_mapping();
+}
@@ -1,4 +1,5 @@
 #include <serializer/json/impl.h>
+#include <serializer/json/fields.h>
 
 using namespace json;
 
@@ -43,49 +44,22 @@ struct format_override<test, Stream> {
 };
 
 struct recursive {
-  std::vector<int> vals;
+  std::vector<int> data;
   std::vector<recursive*> children;
 
   recursive() { }
-  recursive(const std::initializer_list<int>& init) : vals(init) { }
-};
+  recursive(const std::initializer_list<int>& init) : data(init) { }
+  recursive(const recursive&) = delete;
+  recursive& operator = (const recursive&) = delete;
 
-template <>
-struct format_override<recursive, json::OutStream> {
-	template <typename Stream>
-  static void format(Stream& out, const recursive& obj) {
-  	out << "{";
-  	if (obj.vals.size()) {
-    	out << "\"data\":";
-    	::format(out, obj.vals);
-    }
-    if (obj.vals.size() && obj.children.size())
-    	out << ",";
-  	if (obj.children.size()) {
-    	out << "\"children\":";
-      ::format(out, obj.children);
-    }
-    out << "}";
+  ~recursive() {
+    for (auto child : children)
+      delete child;
   }
 };
 
-template <>
-struct format_override<recursive, json::InStream> {
-	template <typename Stream>
-  static void format(Stream& in, recursive& obj) {
-    in >> "{";
-    in >> "\"data\":";
-    ::format(in, obj.vals);
-    if (in)
-    	in >> ",";
-    in.good();
-
-    in >> "\"children\":";
-    ::format(in, obj.children);
-    in.good();
-    in >> "}";
-  }
-};
+// members may come in any order and either may be left out
+SERIALIZER_FIELDS(recursive, data, children)
 
 template <>
 struct format_override<recursive*, json::OutStream> {
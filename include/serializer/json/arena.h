@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+namespace json {
+
+// Monotonic allocator backing a whole document: memory is handed out from large chunks and
+// only returned when the arena is cleared or destroyed. Objects that still own memory outside
+// of the arena (e.g. std::string buffers that outgrew the small string optimization) can be
+// registered with own() so their destructors run at that point.
+struct Arena {
+  explicit Arena(std::size_t chunk_size_ = 16 * 1024)
+    : chunk_size(chunk_size_) { }
+
+  Arena(const Arena&) = delete;
+  Arena& operator = (const Arena&) = delete;
+
+  ~Arena() {
+    clear();
+  }
+
+  void* allocate(std::size_t size, std::size_t align) {
+    auto pos = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t(align) - 1);
+    if (cur == nullptr || pos + size > reinterpret_cast<std::uintptr_t>(end)) {
+      grow(size + align);
+      pos = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t(align) - 1);
+    }
+    cur = reinterpret_cast<char*>(pos + size);
+    return reinterpret_cast<void*>(pos);
+  }
+
+  template <typename T>
+  void own(const T* obj) {
+    cleanups.push_back(Cleanup{&destroy<T>, obj});
+  }
+
+  // runs registered destructors and releases every chunk
+  void clear() {
+    for (auto itr = cleanups.rbegin(); itr != cleanups.rend(); ++itr)
+      itr->fn(itr->obj);
+    cleanups.clear();
+
+    while (head) {
+      auto next = head->next;
+      ::operator delete(head);
+      head = next;
+    }
+    cur = end = nullptr;
+    reserved = 0;
+  }
+
+  // total bytes requested from the system, for diagnostics
+  std::size_t capacity() const {
+    return reserved;
+  }
+
+  // allocation is not synchronized; threads that allocate from one arena at the same time, such
+  // as readers of a LazyDocument, hold this while they do
+  std::mutex mutex;
+
+private:
+  struct Chunk {
+    Chunk* next;
+  };
+
+  struct Cleanup {
+    void (*fn)(const void*);
+    const void* obj;
+  };
+
+  template <typename T>
+  static void destroy(const void* obj) {
+    static_cast<const T*>(obj)->~T();
+  }
+
+  void grow(std::size_t min_size) {
+    // chunks double in size up to a megabyte, so small documents stay small
+    auto size = chunk_size;
+    if (chunk_size < 1024 * 1024)
+      chunk_size *= 2;
+    if (size < min_size + sizeof(Chunk))
+      size = min_size + sizeof(Chunk);
+
+    auto chunk = static_cast<Chunk*>(::operator new(size));
+    chunk->next = head;
+    head = chunk;
+    cur = reinterpret_cast<char*>(chunk + 1);
+    end = reinterpret_cast<char*>(chunk) + size;
+    reserved += size;
+  }
+
+  std::size_t chunk_size;
+  std::size_t reserved = 0;
+  Chunk* head = nullptr;
+  char* cur = nullptr;
+  char* end = nullptr;
+  std::vector<Cleanup> cleanups;
+};
+
+namespace detail {
+
+// Builds the elements of containers that allocate from arena. Types whose moves depend on
+// where they end up (json::Value) specialize this.
+template <typename T>
+struct ArenaConstruct {
+  template <typename... Args>
+  static void construct(Arena*, T* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) T(std::forward<Args>(args)...);
+  }
+};
+
+}
+
+// Allocates from an Arena when one is attached and from the heap otherwise. Copies of a
+// container always start out on the heap, so values copied out of a document own themselves.
+template <typename T>
+struct Allocator {
+  typedef T value_type;
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::false_type propagate_on_container_move_assignment;
+  typedef std::false_type propagate_on_container_swap;
+
+  template <typename U>
+  struct rebind {
+    typedef Allocator<U> other;
+  };
+
+  Allocator() { }
+  explicit Allocator(Arena* arena_) : arena(arena_) { }
+
+  template <typename U>
+  Allocator(const Allocator<U>& other) : arena(other.arena) { }
+
+  T* allocate(std::size_t n) {
+    if (arena)
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, std::size_t) {
+    if (!arena)
+      ::operator delete(ptr);
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    detail::ArenaConstruct<U>::construct(arena, ptr, std::forward<Args>(args)...);
+  }
+
+  Allocator select_on_container_copy_construction() const {
+    return Allocator();
+  }
+
+  Arena* arena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator == (const Allocator<T>& left, const Allocator<U>& right) {
+  return left.arena == right.arena;
+}
+
+template <typename T, typename U>
+bool operator != (const Allocator<T>& left, const Allocator<U>& right) {
+  return left.arena != right.arena;
+}
+
+}
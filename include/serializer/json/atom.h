@@ -0,0 +1,351 @@
+#pragma once
+
+#include <serializer/json/json.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace json {
+
+namespace detail {
+
+inline std::size_t hash_bytes(const char* str, std::size_t len) {
+  std::uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+  for (; len >= 8; str += 8, len -= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, str, 8);
+    h = (h ^ word) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+  std::uint64_t word = 0;
+  std::memcpy(&word, str, len);
+  h = (h ^ word) * 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 29;
+  return static_cast<std::size_t>(h);
+}
+
+struct AtomData {
+  AtomData(std::size_t hash_, const char* str_, std::size_t size, bool interned_)
+    : hash(hash_), str(str_, size), interned(interned_), refs(1) { }
+
+  std::size_t hash;
+  std::string str;
+  // interned data is shared by all equal atoms and never released; other data is counted by
+  // the atoms holding it
+  bool interned;
+  mutable std::atomic<std::size_t> refs;
+};
+
+inline const AtomData* retain_atom(const AtomData* data) {
+  if (!data->interned)
+    data->refs.fetch_add(1, std::memory_order_relaxed);
+  return data;
+}
+
+inline void release_atom(const AtomData* data) {
+  if (!data->interned && data->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete data;
+}
+
+// characters to look an atom up by, with their hash computed once
+struct AtomText {
+  const char* str;
+  std::size_t size;
+  std::size_t hash;
+
+  struct Hash {
+    std::size_t operator () (const AtomText& text) const {
+      return text.hash;
+    }
+  };
+
+  bool operator == (const AtomText& other) const {
+    return size == other.size && std::memcmp(str, other.str, size) == 0;
+  }
+};
+
+typedef std::unordered_map<AtomText, const AtomData*, AtomText::Hash> AtomMap;
+
+// The process wide set of interned strings. Entries are never released, so an atom stays valid
+// for the lifetime of the program; each thread keeps a cache in front of it so that interning
+// known keys takes no lock. The table is bounded: strings longer than max_atom_size are never
+// interned, and once it holds max_atoms strings it is full for good. From then on it no longer
+// changes, so looking up new strings takes no lock either.
+struct AtomTable {
+  static const std::size_t max_atoms = 1 << 16;
+  static const std::size_t max_atom_size = 256;
+
+  static AtomTable& instance() {
+    // deliberately leaked, so atoms held by static values outlive it
+    static AtomTable* table = new AtomTable();
+    return *table;
+  }
+
+  // whether text, if it is not in the table yet, would be added
+  bool admits(const AtomText& text) const {
+    return text.size <= max_atom_size && !full.load(std::memory_order_acquire);
+  }
+
+  const AtomData* find(const AtomText& text, bool insert) {
+    if (text.size > max_atom_size)
+      return nullptr;
+
+    // the last atom seen per hash slot, which catches the keys repeated throughout a document
+    static thread_local const AtomData* recent[256];
+    auto& slot = recent[text.hash & 255];
+    if (slot && slot->hash == text.hash && slot->str.size() == text.size && std::memcmp(slot->str.data(), text.str, text.size) == 0)
+      return slot;
+
+    static thread_local AtomMap cache;
+    auto itr = cache.find(text);
+    if (itr != cache.end())
+      return slot = itr->second;
+
+    const AtomData* data = nullptr;
+    if (full.load(std::memory_order_acquire)) {
+      auto shared = atoms.find(text);
+      if (shared != atoms.end())
+        data = shared->second;
+    }
+    else {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto shared = atoms.find(text);
+      if (shared != atoms.end()) {
+        data = shared->second;
+      }
+      else if (insert && atoms.size() < max_atoms) {
+        auto created = new AtomData(text.hash, text.str, text.size, true);
+        atoms.emplace(AtomText{created->str.data(), created->str.size(), created->hash}, created);
+        data = created;
+        if (atoms.size() == max_atoms)
+          full.store(true, std::memory_order_release);
+      }
+    }
+
+    if (data) {
+      cache.emplace(AtomText{data->str.data(), data->str.size(), data->hash}, data);
+      slot = data;
+    }
+    return data;
+  }
+
+  std::size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return atoms.size();
+  }
+
+private:
+  std::mutex mutex;
+  std::atomic<bool> full{false};
+  AtomMap atoms;
+};
+
+// the interned copy of str, or a counted copy of its own if the table does not take it
+inline const AtomData* intern(const char* str, std::size_t size) {
+  auto hash = hash_bytes(str, size);
+  if (auto data = AtomTable::instance().find(AtomText{str, size, hash}, true))
+    return data;
+  return new AtomData(hash, str, size, false);
+}
+
+}
+
+// An interned string, used for object keys. Equal strings share one immutable copy, so an atom
+// is a single pointer, compares in constant time and hashes to a value computed when it was
+// interned. Interned strings are kept for the lifetime of the program, which suits the bounded
+// vocabulary of keys found in most documents. Keys that are themselves open ended data fill
+// the table up, see AtomTable; strings it does not take get a counted copy per atom instead,
+// which is released with the last atom holding it and compared by its characters.
+struct Atom {
+  Atom()
+    : data(detail::retain_atom(empty())) { }
+
+  Atom(const Atom& other)
+    : data(detail::retain_atom(other.data)) { }
+
+  ~Atom() {
+    detail::release_atom(data);
+  }
+
+  Atom& operator = (const Atom& other) {
+    auto old = data;
+    data = detail::retain_atom(other.data);
+    detail::release_atom(old);
+    return *this;
+  }
+
+  Atom(const char* str)
+    : Atom(str, std::strlen(str)) { }
+
+  Atom(const std::string& str)
+    : Atom(str.data(), str.size()) { }
+
+  Atom(const char* str, std::size_t size)
+    : data(detail::intern(str, size)) { }
+
+  // Looks str up without interning it, since a string the table would take but has not cannot
+  // be a key. Strings it no longer takes may still be keys, so they are copied into atom.
+  static bool find(const char* str, std::size_t size, Atom& atom) {
+    auto& table = detail::AtomTable::instance();
+    detail::AtomText text{str, size, detail::hash_bytes(str, size)};
+    if (auto found = table.find(text, false)) {
+      atom = Atom(found);
+      return true;
+    }
+    if (table.admits(text))
+      return false;
+    atom = Atom(str, size);
+    return true;
+  }
+
+  static bool find(const std::string& str, Atom& atom) {
+    return find(str.data(), str.size(), atom);
+  }
+
+  const std::string& str() const {
+    return data->str;
+  }
+
+  operator const std::string& () const {
+    return data->str;
+  }
+
+  const char* c_str() const {
+    return data->str.c_str();
+  }
+
+  std::size_t size() const {
+    return data->str.size();
+  }
+
+  std::size_t hash() const {
+    return data->hash;
+  }
+
+  const detail::AtomData* data;
+
+private:
+  explicit Atom(const detail::AtomData* data_)
+    : data(data_) { }
+
+  static const detail::AtomData* empty() {
+    static const detail::AtomData* data = detail::intern("", 0);
+    return data;
+  }
+};
+
+// an interned atom is only equal to itself, as strings the table holds are never copied
+// anywhere else; atoms that were not interned both compare their characters
+inline bool operator == (const Atom& left, const Atom& right) {
+  return left.data == right.data ||
+    (!left.data->interned && !right.data->interned && left.data->hash == right.data->hash && left.data->str == right.data->str);
+}
+
+inline bool operator != (const Atom& left, const Atom& right) {
+  return !(left == right);
+}
+
+inline bool operator == (const Atom& left, const std::string& right) {
+  return left.str() == right;
+}
+
+inline bool operator == (const std::string& left, const Atom& right) {
+  return left == right.str();
+}
+
+inline bool operator == (const Atom& left, const char* right) {
+  return left.str() == right;
+}
+
+inline bool operator == (const char* left, const Atom& right) {
+  return right.str() == left;
+}
+
+inline bool operator != (const Atom& left, const std::string& right) {
+  return !(left == right);
+}
+
+inline bool operator != (const std::string& left, const Atom& right) {
+  return !(left == right);
+}
+
+inline bool operator != (const Atom& left, const char* right) {
+  return !(left == right);
+}
+
+inline bool operator != (const char* left, const Atom& right) {
+  return !(left == right);
+}
+
+// orders by content, e.g. for sorted output
+inline bool operator < (const Atom& left, const Atom& right) {
+  return left.data != right.data && left.str() < right.str();
+}
+
+inline std::ostream& operator << (std::ostream& out, const Atom& atom) {
+  return out << atom.str();
+}
+
+namespace detail {
+
+// reads the rest of a string whose opening quote has been consumed, including the closing
+// quote; strings without escapes are interned straight from the input
+inline void read_atom(InStream& in, Atom& atom) {
+  if (!in)
+    return;
+
+  if (in.contiguous()) {
+    auto end = find_quote(in.cur, in.end);
+    if (end != in.end && *end == '"') {
+      atom = Atom(in.cur, static_cast<std::size_t>(end - in.cur));
+      in.cur = end + 1;
+      return;
+    }
+  }
+
+  std::string str;
+  in >> str >> '"';
+  if (in)
+    atom = Atom(str);
+}
+
+}
+
+}
+
+namespace std {
+
+template <>
+struct hash<json::Atom> {
+  std::size_t operator () (const json::Atom& atom) const {
+    return atom.hash();
+  }
+};
+
+}
+
+template <>
+struct string_type<json::Atom> : std::true_type { };
+
+template <>
+struct format_override<json::Atom, json::OutStream> {
+  template <typename Stream>
+  static void format(Stream& out, const json::Atom& atom) {
+    ::format(out, atom.str());
+  }
+};
+
+template <>
+struct format_override<json::Atom, json::InStream> {
+  template <typename Stream>
+  static void format(Stream& in, json::Atom& atom) {
+    in >> '"';
+    json::detail::read_atom(in, atom);
+  }
+};
@@ -0,0 +1,618 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace json {
+
+// A random access binary encoding of a Value tree, meant to be memory mapped and read in place
+// with no parse step. All integers are 32 bit in host byte order (a document written on a host
+// of the other byte order fails to load), and offsets count from the start of the document:
+//
+//   header:  "JSNB", u32 1, u32 document size, u32 offset of the root
+//   null, false, true:  a tag byte
+//   number:  tag, the 8 byte double
+//   integer: tag, an i32, for numbers holding one
+//   string:  tag, u32 length, the bytes, '\0'
+//   array:   tag, u32 count, count element offsets
+//   object:  tag, u32 count, count (key offset, value offset) pairs in member order; above
+//            binary_index members, count member indices ordered by key length and bytes
+//            follow, for binary search
+//
+// Keys are strings stored once per document and shared by every object using them. Elements
+// and values always come after their container, so a document cannot describe a cycle.
+
+namespace detail {
+
+enum class BinaryTag : unsigned char {
+  Null,
+  False,
+  True,
+  Number,
+  Integer,
+  String,
+  Array,
+  Object
+};
+
+const char binary_magic[4] = {'J', 'S', 'N', 'B'};
+const std::size_t binary_header = 16;
+// smaller objects are searched linearly
+const std::uint32_t binary_index = 8;
+
+// orders keys by length first, so most comparisons look at no bytes at all
+inline int compare_keys(const char* str1, std::uint32_t len1, const char* str2, std::uint32_t len2) {
+  if (len1 != len2)
+    return len1 < len2 ? -1 : 1;
+  return std::memcmp(str1, str2, len1);
+}
+
+struct BinaryWriter {
+  std::string out;
+  std::unordered_map<const AtomData*, std::uint32_t> keys;
+
+  std::uint32_t offset() const {
+    if (out.size() > 0xffffffff)
+      throw std::length_error("binary json documents are limited to 4GB");
+    return static_cast<std::uint32_t>(out.size());
+  }
+
+  void put_tag(BinaryTag tag) {
+    out += static_cast<char>(tag);
+  }
+
+  void put_u32(std::uint32_t val) {
+    char bytes[4];
+    std::memcpy(bytes, &val, 4);
+    out.append(bytes, 4);
+  }
+
+  void patch_u32(std::size_t pos, std::uint32_t val) {
+    std::memcpy(&out[pos], &val, 4);
+  }
+
+  // reserves a table of count u32 entries and returns where it starts
+  std::size_t table(std::size_t count) {
+    auto pos = out.size();
+    out.resize(pos + count * 4);
+    return pos;
+  }
+
+  std::uint32_t write_string(const char* str, std::size_t len) {
+    auto pos = offset();
+    put_tag(BinaryTag::String);
+    put_u32(static_cast<std::uint32_t>(len));
+    out.append(str, len);
+    out += '\0';
+    return pos;
+  }
+
+  std::uint32_t write_key(const Atom& key) {
+    auto itr = keys.find(key.data);
+    if (itr != keys.end())
+      return itr->second;
+    auto pos = write_string(key.c_str(), key.size());
+    keys.emplace(key.data, pos);
+    return pos;
+  }
+
+  std::uint32_t write(const Value& lazy) {
+    auto& value = lazy.expanded();
+    auto pos = offset();
+    switch (value.type) {
+      case Value::Type::Object: {
+        const auto& obj = value.data.object->value;
+        auto count = obj.size();
+        put_tag(BinaryTag::Object);
+        put_u32(static_cast<std::uint32_t>(count));
+        auto members = table(count * 2);
+        auto index = count > binary_index ? table(count) : 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+          const auto& member = obj.begin()[i];
+          patch_u32(members + i * 8, write_key(member.first));
+          patch_u32(members + i * 8 + 4, write(member.second));
+        }
+        if (count <= binary_index)
+          break;
+
+        std::vector<std::uint32_t> order(count);
+        for (std::size_t i = 0; i < count; ++i)
+          order[i] = static_cast<std::uint32_t>(i);
+        std::sort(order.begin(), order.end(), [&obj](std::uint32_t i1, std::uint32_t i2) {
+          const auto& key1 = obj.begin()[i1].first;
+          const auto& key2 = obj.begin()[i2].first;
+          return compare_keys(key1.c_str(), static_cast<std::uint32_t>(key1.size()), key2.c_str(), static_cast<std::uint32_t>(key2.size())) < 0;
+        });
+        for (std::size_t i = 0; i < count; ++i)
+          patch_u32(index + i * 4, order[i]);
+        break;
+      }
+      case Value::Type::Array: {
+        const auto& arr = value.data.array->value;
+        put_tag(BinaryTag::Array);
+        put_u32(static_cast<std::uint32_t>(arr.size()));
+        auto elements = table(arr.size());
+        for (std::size_t i = 0; i < arr.size(); ++i)
+          patch_u32(elements + i * 4, write(arr[i]));
+        break;
+      }
+      case Value::Type::String:
+        write_string(value.data.string->value.data(), value.data.string->value.size());
+        break;
+      case Value::Type::Number: {
+        auto num = value.data.number;
+        if (num >= -2147483648.0 && num <= 2147483647.0 && num == std::trunc(num) && !(num == 0 && std::signbit(num))) {
+          put_tag(BinaryTag::Integer);
+          put_u32(static_cast<std::uint32_t>(static_cast<std::int32_t>(num)));
+          break;
+        }
+        put_tag(BinaryTag::Number);
+        char bytes[8];
+        std::memcpy(bytes, &num, 8);
+        out.append(bytes, 8);
+        break;
+      }
+      case Value::Type::Boolean:
+        put_tag(value.data.boolean ? BinaryTag::True : BinaryTag::False);
+        break;
+      default:
+        put_tag(BinaryTag::Null);
+        break;
+    }
+    return pos;
+  }
+};
+
+}
+
+// Encodes value in the binary document format above.
+inline std::string to_binary(const Value& value) {
+  detail::BinaryWriter writer;
+  writer.out.append(detail::binary_magic, 4);
+  writer.put_u32(1);
+  writer.put_u32(0);
+  writer.put_u32(0);
+
+  auto root = writer.write(value);
+  writer.patch_u32(8, writer.offset());
+  writer.patch_u32(12, root);
+  return std::move(writer.out);
+}
+
+// A read only view of one value of a binary document, which must outlive it. Views are three
+// words and reading through them decodes only what is asked for: indexing an array or object
+// reads one table entry, key lookups binary search the sorted index of a large object, and
+// strings are handed out in place. Offsets are checked as they are followed, so a corrupt
+// document throws ParseException rather than reading out of bounds.
+struct BinaryView {
+  BinaryView() { }
+
+  BinaryView(const char* ptr_, std::size_t len_, std::uint32_t pos_)
+    : ptr(ptr_), len(len_), pos(pos_) {
+    if (pos >= len)
+      malformed();
+  }
+
+  struct iterator;
+
+  Value::Type type() const {
+    if (!ptr)
+      return Value::Type::Null;
+    switch (tag()) {
+      case detail::BinaryTag::Null: return Value::Type::Null;
+      case detail::BinaryTag::False:
+      case detail::BinaryTag::True: return Value::Type::Boolean;
+      case detail::BinaryTag::Number:
+      case detail::BinaryTag::Integer: return Value::Type::Number;
+      case detail::BinaryTag::String: return Value::Type::String;
+      case detail::BinaryTag::Array: return Value::Type::Array;
+      case detail::BinaryTag::Object: return Value::Type::Object;
+      default: malformed();
+    }
+    return Value::Type::Null;
+  }
+
+  template <typename Type>
+  bool is() const;
+
+  // Number, Bool, String (a copy), const char* (in place) or Null
+  template <typename Type>
+  Type as() const;
+
+  // elements of an array, members of an object or bytes of a string
+  std::size_t size() const {
+    auto t = type();
+    if (t != Value::Type::Array && t != Value::Type::Object && t != Value::Type::String)
+      throw TypeException("Size of a ", type_name(), " requested");
+    return u32(pos + 1);
+  }
+
+  BinaryView operator [] (std::size_t idx) const {
+    require(detail::BinaryTag::Array, "Array type assertion failed");
+    if (idx >= u32(pos + 1))
+      throw AccessException("Invalid Index: ", idx);
+    return child(static_cast<std::uint32_t>(idx));
+  }
+
+  BinaryView operator [] (int idx) const {
+    if (idx < 0)
+      throw AccessException("Invalid Index: ", idx);
+    return (*this)[static_cast<std::size_t>(idx)];
+  }
+
+  BinaryView operator [] (const std::string& key) const {
+    BinaryView res;
+    if (!find(key.data(), key.size(), res))
+      throw AccessException("Invalid Key: ", key);
+    return res;
+  }
+
+  BinaryView operator [] (const char* key) const {
+    return (*this)[std::string(key)];
+  }
+
+  bool has(const std::string& key) const {
+    BinaryView res;
+    return find(key.data(), key.size(), res);
+  }
+
+  bool has(const char* key) const {
+    BinaryView res;
+    return find(key, std::strlen(key), res);
+  }
+
+  // looks a member up by binary search over the object's sorted index, or by a scan of a small one
+  bool find(const char* name, std::size_t size, BinaryView& res) const {
+    require(detail::BinaryTag::Object, "Object type assertion failed");
+    std::uint32_t count = u32(pos + 1);
+    if (size > 0xffffffff)
+      return false;
+
+    if (count <= detail::binary_index) {
+      for (std::uint32_t i = 0; i < count; ++i) {
+        auto k = key(i);
+        if (detail::compare_keys(k.text(), k.u32(k.pos + 1), name, static_cast<std::uint32_t>(size)) == 0) {
+          res = child(i);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    auto index = static_cast<std::size_t>(pos) + 5 + std::size_t(count) * 8;
+
+    std::uint32_t low = 0, high = count;
+    while (low < high) {
+      auto mid = low + (high - low) / 2;
+      auto member = u32(index + std::size_t(mid) * 4);
+      if (member >= count)
+        malformed();
+      auto k = key(member);
+      auto cmp = detail::compare_keys(k.text(), k.u32(k.pos + 1), name, static_cast<std::uint32_t>(size));
+      if (cmp == 0) {
+        res = child(member);
+        return true;
+      }
+      if (cmp < 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return false;
+  }
+
+  // over the elements of an array or the member values of an object
+  iterator begin() const;
+  iterator end() const;
+
+  // Decodes the viewed value and everything below it into a Value tree. Each value written by
+  // to_binary has bytes of its own, so a document that decodes to more values than it has
+  // bytes shares children between containers, which could expand it exponentially; it throws
+  // ParseException instead.
+  Value to_value() const {
+    auto budget = len;
+    return to_value(budget);
+  }
+
+private:
+  Value to_value(std::size_t& budget) const {
+    if (budget-- == 0)
+      malformed();
+
+    switch (type()) {
+      case Value::Type::Object: {
+        std::uint32_t count = u32(pos + 1);
+        Object obj;
+        // counts are bounded by the document size, as every entry takes at least four bytes
+        obj.reserve(std::min<std::size_t>(count, len / 8));
+        for (std::uint32_t i = 0; i < count; ++i) {
+          auto k = key(i);
+          obj.emplace(Atom(k.text(), k.u32(k.pos + 1)), child(i).to_value(budget));
+        }
+        return Value(std::move(obj));
+      }
+      case Value::Type::Array: {
+        std::uint32_t count = u32(pos + 1);
+        Array arr;
+        arr.reserve(std::min<std::size_t>(count, len / 4));
+        for (std::uint32_t i = 0; i < count; ++i)
+          arr.push_back(child(i).to_value(budget));
+        return Value(std::move(arr));
+      }
+      case Value::Type::String:
+        return Value(String(text(), u32(pos + 1)));
+      case Value::Type::Number:
+        return Value(number());
+      case Value::Type::Boolean:
+        return Value(tag() == detail::BinaryTag::True);
+      default:
+        return Value();
+    }
+  }
+
+  static void malformed() {
+    throw ParseException("Malformed binary json document");
+  }
+
+  detail::BinaryTag tag() const {
+    return static_cast<detail::BinaryTag>(ptr[pos]);
+  }
+
+  const char* type_name() const {
+    switch (type()) {
+      case Value::Type::Object: return "Object";
+      case Value::Type::Array: return "Array";
+      case Value::Type::String: return "String";
+      case Value::Type::Number: return "Number";
+      case Value::Type::Boolean: return "Bool";
+      default: return "Null";
+    }
+  }
+
+  void require(detail::BinaryTag expected, const char* message) const {
+    if (!ptr || tag() != expected)
+      throw TypeException(message);
+  }
+
+  std::uint32_t u32(std::size_t at) const {
+    if (at + 4 > len)
+      malformed();
+    std::uint32_t res;
+    std::memcpy(&res, ptr + at, 4);
+    return res;
+  }
+
+  double number() const {
+    if (tag() == detail::BinaryTag::Integer)
+      return static_cast<std::int32_t>(u32(pos + 1));
+    if (static_cast<std::size_t>(pos) + 9 > len)
+      malformed();
+    double res;
+    std::memcpy(&res, ptr + pos + 1, 8);
+    return res;
+  }
+
+  // the bytes of a string, checked to lie within the document and to be terminated
+  const char* text() const {
+    auto end = static_cast<std::size_t>(pos) + 5 + u32(pos + 1);
+    if (end >= len || ptr[end] != '\0')
+      malformed();
+    return ptr + pos + 5;
+  }
+
+  // the idx-th element or member value; it must come after its container
+  BinaryView child(std::uint32_t idx) const {
+    auto entry = tag() == detail::BinaryTag::Object ? std::size_t(idx) * 8 + 4 : std::size_t(idx) * 4;
+    auto at = u32(static_cast<std::size_t>(pos) + 5 + entry);
+    if (at <= pos)
+      malformed();
+    return BinaryView(ptr, len, at);
+  }
+
+  BinaryView key(std::uint32_t idx) const {
+    require(detail::BinaryTag::Object, "Object type assertion failed");
+    BinaryView res(ptr, len, u32(static_cast<std::size_t>(pos) + 5 + std::size_t(idx) * 8));
+    if (res.tag() != detail::BinaryTag::String)
+      malformed();
+    return res;
+  }
+
+  const char* ptr = nullptr;
+  std::size_t len = 0;
+  std::uint32_t pos = 0;
+};
+
+struct BinaryView::iterator {
+  typedef std::forward_iterator_tag iterator_category;
+  typedef BinaryView value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const BinaryView* pointer;
+  typedef BinaryView reference;
+
+  iterator(const BinaryView& parent_, std::uint32_t idx_)
+    : parent(parent_), idx(idx_) { }
+
+  // the element, or the member's value
+  BinaryView operator * () const {
+    return parent.child(idx);
+  }
+
+  BinaryView value() const {
+    return parent.child(idx);
+  }
+
+  // the member's key, for objects
+  BinaryView key() const {
+    return parent.key(idx);
+  }
+
+  iterator& operator ++ () {
+    ++idx;
+    return *this;
+  }
+
+  iterator operator ++ (int) {
+    auto res = *this;
+    ++idx;
+    return res;
+  }
+
+  bool operator == (const iterator& other) const {
+    return idx == other.idx && parent.pos == other.parent.pos && parent.ptr == other.parent.ptr;
+  }
+
+  bool operator != (const iterator& other) const {
+    return !(*this == other);
+  }
+
+private:
+  BinaryView parent;
+  std::uint32_t idx;
+};
+
+inline BinaryView::iterator BinaryView::begin() const {
+  auto t = type();
+  if (t != Value::Type::Array && t != Value::Type::Object)
+    throw TypeException("Iteration over a ", type_name(), " requested");
+  return iterator(*this, 0);
+}
+
+inline BinaryView::iterator BinaryView::end() const {
+  auto t = type();
+  if (t != Value::Type::Array && t != Value::Type::Object)
+    throw TypeException("Iteration over a ", type_name(), " requested");
+  return iterator(*this, u32(pos + 1));
+}
+
+template <>
+inline bool BinaryView::is<Object>() const {
+  return type() == Value::Type::Object;
+}
+
+template <>
+inline bool BinaryView::is<Array>() const {
+  return type() == Value::Type::Array;
+}
+
+template <>
+inline bool BinaryView::is<String>() const {
+  return type() == Value::Type::String;
+}
+
+template <>
+inline bool BinaryView::is<Number>() const {
+  return type() == Value::Type::Number;
+}
+
+template <>
+inline bool BinaryView::is<Bool>() const {
+  return type() == Value::Type::Boolean;
+}
+
+template <>
+inline bool BinaryView::is<Null>() const {
+  return type() == Value::Type::Null;
+}
+
+template <>
+inline Number BinaryView::as<Number>() const {
+  if (type() != Value::Type::Number)
+    throw TypeException("Number type assertion failed");
+  return number();
+}
+
+template <>
+inline Bool BinaryView::as<Bool>() const {
+  if (type() != Value::Type::Boolean)
+    throw TypeException("Bool type assertion failed");
+  return tag() == detail::BinaryTag::True;
+}
+
+template <>
+inline const char* BinaryView::as<const char*>() const {
+  require(detail::BinaryTag::String, "String type assertion failed");
+  return text();
+}
+
+template <>
+inline String BinaryView::as<String>() const {
+  require(detail::BinaryTag::String, "String type assertion failed");
+  return String(text(), u32(pos + 1));
+}
+
+template <>
+inline Null BinaryView::as<Null>() const {
+  if (type() != Value::Type::Null)
+    throw TypeException("Null type assertion failed");
+  return Null();
+}
+
+// Holds a binary document, either mapped from a file or kept in memory, and hands out views of
+// it. Loading checks only the header, so opening a file of any size takes constant time and
+// pages are read as views touch them.
+struct BinaryDocument {
+  BinaryDocument() { }
+
+  BinaryDocument(const BinaryDocument&) = delete;
+  BinaryDocument& operator = (const BinaryDocument&) = delete;
+
+  // the bytes are kept inside the document
+  bool parse(std::string str) {
+    clear();
+    bytes = std::move(str);
+    return load(bytes.data(), bytes.size());
+  }
+
+  // data must outlive the document
+  bool parse(const char* data, std::size_t size) {
+    clear();
+    return load(data, size);
+  }
+
+  // the mapping is kept until the document is cleared or reloaded
+  bool open(const std::string& path) {
+    clear();
+    return file.open(path) && load(file.data(), file.size());
+  }
+
+  void clear() {
+    view = BinaryView();
+    file.close();
+    std::string().swap(bytes);
+  }
+
+  BinaryView root() const {
+    return view;
+  }
+
+private:
+  bool load(const char* data, std::size_t size) {
+    std::uint32_t marker, total, root;
+    if (size < detail::binary_header || std::memcmp(data, detail::binary_magic, 4) != 0)
+      return false;
+    std::memcpy(&marker, data + 4, 4);
+    std::memcpy(&total, data + 8, 4);
+    std::memcpy(&root, data + 12, 4);
+    if (marker != 1 || total != size || root < detail::binary_header || root >= size)
+      return false;
+
+    view = BinaryView(data, size, root);
+    return true;
+  }
+
+  MappedFile file;
+  std::string bytes;
+  BinaryView view;
+};
+
+}
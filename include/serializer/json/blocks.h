@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace json {
+
+namespace detail {
+
+// bit i of each mask stands for byte i of a 64 byte block
+struct BlockMasks {
+  std::uint64_t quote;
+  std::uint64_t backslash;
+  std::uint64_t op;
+  std::uint64_t open;
+  std::uint64_t close;
+  std::uint64_t space;
+};
+
+inline void classify(const char* block, BlockMasks& masks) {
+  masks = BlockMasks{0, 0, 0, 0, 0, 0};
+#if defined(__AVX2__)
+  for (int shift = 0; shift < 64; shift += 32) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + shift));
+    // '[' and ']' differ from '{' and '}' only in bit 0x20
+    auto lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    auto open = _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{'));
+    auto close = _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'));
+    auto op = _mm256_or_si256(
+      _mm256_or_si256(open, close),
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+    auto space = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+
+    masks.quote |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))))) << shift;
+    masks.backslash |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))))) << shift;
+    masks.op |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(op))) << shift;
+    masks.open |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(open))) << shift;
+    masks.close |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(close))) << shift;
+    masks.space |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(space))) << shift;
+  }
+#elif defined(__SSE2__)
+  for (int shift = 0; shift < 64; shift += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + shift));
+    auto lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    auto open = _mm_cmpeq_epi8(lower, _mm_set1_epi8('{'));
+    auto close = _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'));
+    auto op = _mm_or_si128(
+      _mm_or_si128(open, close),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+    auto space = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+
+    masks.quote |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))))) << shift;
+    masks.backslash |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))))) << shift;
+    masks.op |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(op))) << shift;
+    masks.open |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(open))) << shift;
+    masks.close |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(close))) << shift;
+    masks.space |= std::uint64_t(static_cast<std::uint32_t>(_mm_movemask_epi8(space))) << shift;
+  }
+#else
+  for (int i = 0; i < 64; ++i) {
+    auto bit = std::uint64_t(1) << i;
+    switch (block[i]) {
+      case '"': masks.quote |= bit; break;
+      case '\\': masks.backslash |= bit; break;
+      case '{': case '[': masks.op |= bit; masks.open |= bit; break;
+      case '}': case ']': masks.op |= bit; masks.close |= bit; break;
+      case ':': case ',': masks.op |= bit; break;
+      case ' ': case '\t': case '\n': case '\r': masks.space |= bit; break;
+    }
+  }
+#endif
+}
+
+inline unsigned first_bit64(std::uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long idx;
+  _BitScanForward64(&idx, mask);
+  return idx;
+#else
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// bit i is set when an odd number of bits at or below i are set
+inline std::uint64_t prefix_xor(std::uint64_t mask) {
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+// characters preceded by an unescaped backslash; carry tells whether the block starts escaped.
+// backslashes are rare outside of a few strings, so they are simply walked one by one
+inline std::uint64_t escaped_mask(std::uint64_t backslash, std::uint64_t& carry) {
+  std::uint64_t escaped = carry;
+  backslash &= ~carry;
+  carry = 0;
+  while (backslash) {
+    auto bit = first_bit64(backslash);
+    if (bit == 63) {
+      carry = 1;
+      break;
+    }
+    escaped |= std::uint64_t(1) << (bit + 1);
+    backslash &= ~(std::uint64_t(3) << bit);
+  }
+  return escaped;
+}
+
+// Returns the end of the array or object starting at itr, skipping over its contents without
+// parsing them, or nullptr if it is not closed before end. Brackets are only counted, not paired,
+// so a mismatched one is left for whoever parses the contents.
+inline const char* skip_container(const char* itr, const char* end) {
+  std::uint64_t escape_carry = 0;
+  std::uint64_t string_carry = 0;
+  std::size_t depth = 0;
+  char tail[64];
+
+  for (auto base = itr; base < end; base += 64) {
+    auto block = base;
+    if (end - base < 64) {
+      std::memset(tail, ' ', sizeof(tail));
+      std::memcpy(tail, block, static_cast<std::size_t>(end - base));
+      block = tail;
+    }
+
+    BlockMasks masks;
+    classify(block, masks);
+
+    auto quotes = masks.quote & ~escaped_mask(masks.backslash, escape_carry);
+    auto in_string = prefix_xor(quotes) ^ string_carry;
+    string_carry = std::uint64_t(0) - (in_string >> 63);
+
+    auto open = masks.open & ~in_string;
+    auto close = masks.close & ~in_string;
+    for (auto brackets = open | close; brackets; brackets &= brackets - 1) {
+      auto bit = first_bit64(brackets);
+      if (open >> bit & 1)
+        ++depth;
+      else if (--depth == 0)
+        return base + bit + 1;
+    }
+  }
+  return nullptr;
+}
+
+}
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+#include <serializer/json/events.h>
+#include <serializer/json/path.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace json {
+
+// Pulls the elements of one array out of a document one at a time. The cursor skips ahead to
+// the array named by a json pointer such as "/features" and then parses a single element per
+// call to next(), so only the current element is ever held in memory when reading from a
+// std::istream. Elements are read through ::format, so next() accepts a Value or any type with
+// a json::InStream formatter.
+//
+//   ArrayCursor features(file, "/features");
+//   Value feature;
+//   while (features.next(feature))
+//     ...
+//
+// next() returns false once the array is exhausted or the input turns out to be malformed;
+// failed() tells the two apart.
+struct ArrayCursor {
+  ArrayCursor(InStream& in_, const std::string& path)
+    : in(in_) {
+    seek(path);
+  }
+
+  ArrayCursor(std::istream& input, const std::string& path)
+    : owned(new InStream(input)), in(*owned) {
+    seek(path);
+  }
+
+  ArrayCursor(const char* data, std::size_t size, const std::string& path)
+    : owned(new InStream(data, size)), in(*owned) {
+    seek(path);
+  }
+
+  ArrayCursor(const char* str, const std::string& path)
+    : ArrayCursor(str, std::strlen(str), path) { }
+
+  ArrayCursor(const std::string& contents, const std::string& path)
+    : ArrayCursor(contents.data(), contents.size(), path) { }
+
+  ArrayCursor(std::string&& contents, const std::string& path)
+    : owned(new InStream(std::move(contents))), in(*owned) {
+    seek(path);
+  }
+
+  ArrayCursor(const ArrayCursor&) = delete;
+  ArrayCursor& operator = (const ArrayCursor&) = delete;
+
+  template <typename T>
+  bool next(T& element) {
+    if (finished)
+      return false;
+
+    if (started) {
+      auto c = in.peek();
+      if (c == ']') {
+        in >> ']';
+        finished = true;
+        return false;
+      }
+      if (c != ',') {
+        fail();
+        return false;
+      }
+      in >> ',';
+    }
+
+    // formatters append into containers, so every element starts out fresh
+    started = true;
+    element = T();
+    ::format(in, element);
+    if (!in) {
+      fail();
+      return false;
+    }
+    ++count;
+    return true;
+  }
+
+  // true when the path was not found or the document is malformed
+  bool failed() const {
+    return error;
+  }
+
+  // number of elements read so far
+  std::size_t index() const {
+    return count;
+  }
+
+private:
+  void fail() {
+    in.bad();
+    error = finished = true;
+  }
+
+  bool skip() {
+    detail::SkipHandler handler;
+    return parse_events(in, handler);
+  }
+
+  bool enter_member(const std::string& name) {
+    in >> '{';
+    if (in.peek() == '}')
+      return false;
+
+    std::string key;
+    while (true) {
+      key.clear();
+      if (in.peek() != '"' || !(in >> '"' >> key >> '"') || !in.trim(':'))
+        return false;
+      if (key == name)
+        return true;
+      if (!skip() || in.peek() != ',')
+        return false;
+      in >> ',';
+    }
+  }
+
+  bool enter_element(const std::string& token) {
+    auto idx = detail::pointer_index(token);
+    if (idx == Path::npos)
+      return false;
+
+    in >> '[';
+    if (in.peek() == ']')
+      return false;
+    for (; idx > 0; --idx) {
+      if (!skip() || in.peek() != ',')
+        return false;
+      in >> ',';
+    }
+    return true;
+  }
+
+  void seek(const std::string& path) {
+    for (const auto& token : detail::pointer_tokens(path)) {
+      auto c = in.peek();
+      bool found = c == '{' ? enter_member(token) : c == '[' ? enter_element(token) : false;
+      if (!found) {
+        fail();
+        return;
+      }
+    }
+
+    if (in.peek() != '[') {
+      fail();
+      return;
+    }
+    in >> '[';
+    if (in.peek() == ']') {
+      in >> ']';
+      finished = true;
+    }
+  }
+
+  std::unique_ptr<InStream> owned;
+  InStream& in;
+  bool started = false;
+  bool finished = false;
+  bool error = false;
+  std::size_t count = 0;
+};
+
+}
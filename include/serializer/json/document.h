@@ -0,0 +1,84 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+
+namespace json {
+
+// Owns an Arena and a Value tree parsed into it. Every node, string and container buffer of the
+// tree comes from the arena, so discarding the document is a handful of chunk frees rather than
+// a walk over the whole tree. References into root() must not outlive the document, but values
+// copied or moved out of it are copied onto the heap and do. Containers of the document that are
+// changed are destroyed with it, releasing the heap values assigned into them.
+struct Document {
+  Document() { }
+
+  explicit Document(std::size_t chunk_size)
+    : arena(chunk_size) { }
+
+  Document(const Document&) = delete;
+  Document& operator = (const Document&) = delete;
+
+  bool parse(const std::string& str) {
+    return parse(str.data(), str.size());
+  }
+
+  bool parse(const char* data, std::size_t size) {
+    InStream ssi(data, size);
+    return parse(ssi);
+  }
+
+  bool parse(std::istream& in) {
+    InStream ssi(in);
+    if (!parse(ssi)) {
+      in.setstate(std::ios_base::failbit);
+      return false;
+    }
+    return true;
+  }
+
+  // Parses a file through a memory mapping, which is kept until the document is cleared or
+  // parsed again. Strings without escapes that are too long to be stored inline are not copied
+  // but read from the mapping, see Value::view(); keys are interned as usual.
+  bool open(const std::string& path) {
+    clear();
+    if (!file.open(path))
+      return false;
+    InStream in(file.data(), file.size());
+    in.views = true;
+    return load(in);
+  }
+
+  bool parse(InStream& in) {
+    clear();
+    return load(in);
+  }
+
+  void clear() {
+    value = nullptr;
+    arena.clear();
+    file.close();
+  }
+
+  Value& root() {
+    return value;
+  }
+
+  const Value& root() const {
+    return value;
+  }
+
+  Arena arena;
+
+private:
+  bool load(InStream& in) {
+    in.arena = &arena;
+    format(in, value);
+    in.arena = nullptr;
+    return in;
+  }
+
+  MappedFile file;
+  Value value;
+};
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <serializer/json/json.h>
+
+#include <string>
+#include <istream>
+#include <utility>
+
+namespace json {
+
+// Event driven parsing: the document is walked once and reported to a handler as it is read,
+// without building a Value. The handler is any type providing
+//
+//   void start_object();            void end_object();
+//   void start_array();             void end_array();
+//   void key(std::string& name);    void string(std::string& str);
+//   void number(double val);        void boolean(bool val);
+//   void null();
+//
+// resolved at compile time. Callbacks the handler leaves out are skipped, so a handler only
+// defines the events it cares about and the others compile down to nothing. Keys and strings are
+// unescaped into one buffer that is reused for the whole parse; handlers that keep them should
+// copy or move them out. Parsing stops at the first syntax error, after which the handler may
+// have seen a prefix of the document.
+namespace detail {
+
+// on::name(handler, 0, args...) calls handler.name(args...), or nothing if there is no such member
+namespace on {
+
+#define JSON_EVENT_CALLBACK(name) \
+template <typename Handler, typename... Args> \
+auto name(Handler& handler, int, Args&&... args) -> decltype(handler.name(std::forward<Args>(args)...), void()) { \
+  handler.name(std::forward<Args>(args)...); \
+} \
+\
+template <typename Handler, typename... Args> \
+void name(Handler&, long, Args&&...) { }
+
+JSON_EVENT_CALLBACK(start_object)
+JSON_EVENT_CALLBACK(end_object)
+JSON_EVENT_CALLBACK(start_array)
+JSON_EVENT_CALLBACK(end_array)
+JSON_EVENT_CALLBACK(key)
+JSON_EVENT_CALLBACK(string)
+JSON_EVENT_CALLBACK(number)
+JSON_EVENT_CALLBACK(boolean)
+JSON_EVENT_CALLBACK(null)
+
+#undef JSON_EVENT_CALLBACK
+
+}
+
+template <typename Handler>
+struct EventParser {
+  InStream& in;
+  Handler& handler;
+  std::string buffer;
+
+  bool text() {
+    buffer.clear();
+    in >> '"' >> buffer >> '"';
+    return in;
+  }
+
+  bool object() {
+    in >> '{';
+    on::start_object(handler, 0);
+    if (in.peek() == '}') {
+      in >> '}';
+      on::end_object(handler, 0);
+      return true;
+    }
+
+    do {
+      if (in.peek() != '"' || !text())
+        return false;
+      on::key(handler, 0, buffer);
+      if (!in.trim(':') || !value())
+        return false;
+    }
+    while (in.peek() == ',' && in >> ',');
+
+    if (!(in >> '}'))
+      return false;
+    on::end_object(handler, 0);
+    return true;
+  }
+
+  bool array() {
+    in >> '[';
+    on::start_array(handler, 0);
+    if (in.peek() == ']') {
+      in >> ']';
+      on::end_array(handler, 0);
+      return true;
+    }
+
+    do {
+      if (!value())
+        return false;
+    }
+    while (in.peek() == ',' && in >> ',');
+
+    if (!(in >> ']'))
+      return false;
+    on::end_array(handler, 0);
+    return true;
+  }
+
+  bool value() {
+    switch (in.peek()) {
+      case '{':
+        return object();
+      case '[':
+        return array();
+      case '"':
+        if (!text())
+          return false;
+        on::string(handler, 0, buffer);
+        return true;
+      case 't':
+        if (!(in >> "true"))
+          return false;
+        on::boolean(handler, 0, true);
+        return true;
+      case 'f':
+        if (!(in >> "false"))
+          return false;
+        on::boolean(handler, 0, false);
+        return true;
+      case 'n':
+        if (!(in >> "null"))
+          return false;
+        on::null(handler, 0);
+        return true;
+      case '-':
+      case '0': case '1': case '2': case '3': case '4':
+      case '5': case '6': case '7': case '8': case '9': {
+        double val;
+        if (!(in >> val))
+          return false;
+        on::number(handler, 0, val);
+        return true;
+      }
+      default:
+        in.bad();
+        return false;
+    }
+  }
+};
+
+// ignores every event, for skipping over values
+struct SkipHandler { };
+
+}
+
+// reports one value read from in; leaves in failed on a syntax error
+template <typename Handler>
+bool parse_events(InStream& in, Handler& handler) {
+  if (!in)
+    return false;
+
+  detail::EventParser<Handler> parser{in, handler, std::string()};
+  if (!parser.value())
+    in.bad();
+  return in;
+}
+
+template <typename Handler>
+bool parse_events(const char* data, std::size_t size, Handler& handler) {
+  InStream in(data, size);
+  return parse_events(in, handler);
+}
+
+template <typename Handler>
+bool parse_events(const std::string& str, Handler& handler) {
+  return parse_events(str.data(), str.size(), handler);
+}
+
+template <typename Handler>
+bool parse_events(std::istream& input, Handler& handler) {
+  InStream in(input);
+  if (!parse_events(in, handler)) {
+    input.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <serializer/json/json.h>
+#include <serializer/json/blocks.h>
+#include <serializer/json/events.h>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace json {
+
+namespace detail {
+
+template <typename T>
+struct FieldReader {
+  const char* name;
+  std::size_t size;
+  void (*read)(InStream&, T&);
+};
+
+// key is ",\"name\":"; the first member goes without the comma
+template <std::size_t size>
+void write_key(OutStream& out, bool& first, const char (&key)[size]) {
+  out.write(key + first, size - 1 - first);
+  first = false;
+}
+
+// reads a key whose opening quote is next; keys without escapes are used straight from the input
+inline bool read_key(InStream& in, std::string& buffer, const char*& key, std::size_t& size) {
+  in >> '"';
+  if (in && in.contiguous()) {
+    auto end = find_quote(in.cur, in.end);
+    if (end != in.end && *end == '"') {
+      key = in.cur;
+      size = static_cast<std::size_t>(end - in.cur);
+      in.cur = end + 1;
+      return true;
+    }
+  }
+
+  buffer.clear();
+  in >> buffer >> '"';
+  key = buffer.data();
+  size = buffer.size();
+  return in;
+}
+
+// Skips over a value without building it. In a contiguous buffer strings and containers are
+// only scanned for their end, so the contents of an unknown field are not validated.
+inline bool skip_value(InStream& in) {
+  auto c = in.peek();
+  if (in.contiguous() && (c == '{' || c == '[')) {
+    auto end = skip_container(in.cur, in.end);
+    if (!end) {
+      in.bad();
+      return false;
+    }
+    in.cur = end;
+    return true;
+  }
+
+  if (in.contiguous() && c == '"') {
+    for (auto itr = in.cur + 1;;) {
+      itr = find_quote(itr, in.end);
+      if (itr == in.end || (*itr == '\\' && in.end - itr < 2)) {
+        in.bad();
+        return false;
+      }
+      if (*itr == '"') {
+        in.cur = itr + 1;
+        return true;
+      }
+      itr += 2;
+    }
+  }
+
+  SkipHandler handler;
+  return parse_events(in, handler);
+}
+
+// Reads an object into the fields of obj. Members may come in any order; each is looked up
+// starting after the previous match, so members in declaration order match on the first
+// comparison. Unknown members are skipped and missing ones leave their field untouched.
+template <typename T>
+void read_fields(InStream& in, T& obj, const FieldReader<T>* fields, std::size_t count) {
+  if (!in.trim('{'))
+    return;
+  if (in.peek() == '}') {
+    in >> '}';
+    return;
+  }
+
+  std::string buffer;
+  std::size_t next = 0;
+  do {
+    const char* key = nullptr;
+    std::size_t size = 0;
+    if (in.peek() != '"' || !read_key(in, buffer, key, size) || !in.trim(':')) {
+      in.bad();
+      return;
+    }
+
+    auto idx = count;
+    for (std::size_t i = 0; i < count; ++i) {
+      auto candidate = next + i < count ? next + i : next + i - count;
+      if (fields[candidate].size == size && std::memcmp(fields[candidate].name, key, size) == 0) {
+        idx = candidate;
+        break;
+      }
+    }
+
+    if (idx < count) {
+      fields[idx].read(in, obj);
+      next = idx + 1;
+    }
+    else {
+      skip_value(in);
+    }
+    if (!in)
+      return;
+  }
+  while (in.peek() == ',' && in >> ',');
+
+  in >> '}';
+}
+
+}
+
+}
+
+#define SERIALIZER_EXPAND(x) x
+#define SERIALIZER_CONCAT(a, b) SERIALIZER_CONCAT_IMPL(a, b)
+#define SERIALIZER_CONCAT_IMPL(a, b) a##b
+
+#define SERIALIZER_COUNT(...) SERIALIZER_EXPAND(SERIALIZER_COUNT_IMPL(__VA_ARGS__, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define SERIALIZER_COUNT_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, count, ...) count
+
+// applies macro(type, field) to each of up to 64 fields
+#define SERIALIZER_FOR_EACH(macro, type, ...) \
+  SERIALIZER_EXPAND(SERIALIZER_CONCAT(SERIALIZER_FOR_EACH_, SERIALIZER_COUNT(__VA_ARGS__))(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_1(macro, type, field) macro(type, field)
+#define SERIALIZER_FOR_EACH_2(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_1(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_3(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_2(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_4(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_3(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_5(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_4(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_6(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_5(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_7(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_6(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_8(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_7(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_9(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_8(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_10(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_9(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_11(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_10(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_12(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_11(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_13(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_12(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_14(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_13(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_15(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_14(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_16(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_15(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_17(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_16(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_18(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_17(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_19(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_18(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_20(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_19(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_21(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_20(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_22(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_21(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_23(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_22(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_24(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_23(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_25(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_24(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_26(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_25(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_27(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_26(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_28(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_27(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_29(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_28(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_30(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_29(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_31(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_30(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_32(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_31(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_33(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_32(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_34(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_33(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_35(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_34(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_36(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_35(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_37(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_36(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_38(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_37(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_39(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_38(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_40(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_39(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_41(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_40(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_42(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_41(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_43(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_42(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_44(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_43(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_45(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_44(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_46(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_45(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_47(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_46(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_48(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_47(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_49(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_48(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_50(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_49(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_51(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_50(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_52(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_51(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_53(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_52(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_54(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_53(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_55(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_54(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_56(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_55(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_57(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_56(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_58(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_57(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_59(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_58(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_60(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_59(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_61(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_60(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_62(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_61(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_63(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_62(macro, type, __VA_ARGS__))
+#define SERIALIZER_FOR_EACH_64(macro, type, field, ...) macro(type, field) SERIALIZER_EXPAND(SERIALIZER_FOR_EACH_63(macro, type, __VA_ARGS__))
+
+// field names are identifiers, so quoting them is all the escaping their keys need
+#define SERIALIZER_WRITE_FIELD(Type, field) \
+  json::detail::write_key(out, first, ",\"" #field "\":"); \
+  ::format(out, obj.field);
+
+// a member present in the input replaces the field, rather than being appended to it
+#define SERIALIZER_READ_FIELD(Type, field) \
+  { #field, sizeof(#field) - 1, [](json::InStream& in, Type& obj) { obj.field = {}; ::format(in, obj.field); } },
+
+// Generates the json::OutStream and json::InStream format_overrides of a struct from a list of
+// its fields, which are written in the listed order under their own names:
+//
+//   struct Point { double x, y; std::string label; };
+//   SERIALIZER_FIELDS(Point, x, y, label)
+//
+// Reading accepts the members in any order, skips unknown ones and leaves the fields of missing
+// ones as they were, so defaults set before reading act as the values of optional fields. Like
+// any format_override specialization, it has to be used at global namespace scope.
+#define SERIALIZER_FIELDS(Type, ...) \
+  template <> \
+  struct format_override<Type, json::OutStream> { \
+    template <typename Stream> \
+    static void format(Stream& out, const Type& obj) { \
+      bool first = true; \
+      out.put('{'); \
+      SERIALIZER_FOR_EACH(SERIALIZER_WRITE_FIELD, Type, __VA_ARGS__) \
+      out.put('}'); \
+    } \
+  }; \
+  \
+  template <> \
+  struct format_override<Type, json::InStream> { \
+    template <typename Stream> \
+    static void format(Stream& in, Type& obj) { \
+      static const json::detail::FieldReader<Type> fields[] = { \
+        SERIALIZER_FOR_EACH(SERIALIZER_READ_FIELD, Type, __VA_ARGS__) \
+      }; \
+      json::detail::read_fields(in, obj, fields, sizeof(fields) / sizeof(fields[0])); \
+    } \
+  };
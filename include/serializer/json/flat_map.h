@@ -0,0 +1,566 @@
+#pragma once
+
+#include <serializer/json/atom.h>
+#include <serializer/string_escaper.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace json {
+
+namespace detail {
+
+// position of key in keys[0, count), or count
+template <typename Key>
+std::size_t scan_keys(const Key* keys, std::size_t count, const Key& key) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (keys[i] == key)
+      return i;
+  }
+  return count;
+}
+
+// interned atoms are equal exactly when their pointers are, so several are compared at once
+inline std::size_t scan_keys(const Atom* keys, std::size_t count, const Atom& key) {
+  static_assert(sizeof(Atom) == sizeof(void*), "an atom is a single pointer");
+  std::size_t i = 0;
+  if (!key.data->interned) {
+    for (; i < count; ++i) {
+      if (keys[i] == key)
+        return i;
+    }
+    return count;
+  }
+#if defined(__AVX2__)
+  const __m256i target = _mm256_set1_epi64x(static_cast<long long>(reinterpret_cast<std::uintptr_t>(key.data)));
+  for (; count - i >= 4; i += 4) {
+    auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    auto mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(chunk, target))));
+    if (mask)
+      return i + escaper::first_bit(mask);
+  }
+#elif defined(__SSE2__) && (defined(__x86_64__) || defined(_M_X64))
+  // no 64 bit compare before SSE4.1: a pointer matches when both of its halves do
+  const __m128i target = _mm_set1_epi64x(static_cast<long long>(reinterpret_cast<std::uintptr_t>(key.data)));
+  for (; count - i >= 4; i += 4) {
+    auto lo = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), target);
+    auto hi = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i + 2)), target);
+    auto mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(lo))) |
+                static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(hi))) << 4;
+    mask &= mask >> 1;
+    mask &= 0x55;
+    if (mask)
+      return i + escaper::first_bit(mask) / 2;
+  }
+#endif
+  for (; i < count; ++i) {
+    if (keys[i] == key)
+      return i;
+  }
+  return count;
+}
+
+// Walks the entries of a FlatMap through its table of entry pointers, in insertion order.
+template <typename V>
+struct FlatMapIterator {
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef typename std::remove_const<V>::type value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef V* pointer;
+  typedef V& reference;
+
+  FlatMapIterator()
+    : pos(nullptr) { }
+
+  explicit FlatMapIterator(value_type* const* pos_)
+    : pos(pos_) { }
+
+  // an iterator converts to a const_iterator
+  template <typename U, typename = typename std::enable_if<std::is_same<const U, V>::value && !std::is_same<U, V>::value>::type>
+  FlatMapIterator(const FlatMapIterator<U>& other)
+    : pos(other.pos) { }
+
+  reference operator * () const { return **pos; }
+  pointer operator -> () const { return *pos; }
+  reference operator [] (difference_type n) const { return *pos[n]; }
+
+  FlatMapIterator& operator ++ () { ++pos; return *this; }
+  FlatMapIterator& operator -- () { --pos; return *this; }
+  FlatMapIterator operator ++ (int) { return FlatMapIterator(pos++); }
+  FlatMapIterator operator -- (int) { return FlatMapIterator(pos--); }
+  FlatMapIterator& operator += (difference_type n) { pos += n; return *this; }
+  FlatMapIterator& operator -= (difference_type n) { pos -= n; return *this; }
+  FlatMapIterator operator + (difference_type n) const { return FlatMapIterator(pos + n); }
+  FlatMapIterator operator - (difference_type n) const { return FlatMapIterator(pos - n); }
+  difference_type operator - (const FlatMapIterator& other) const { return pos - other.pos; }
+
+  bool operator == (const FlatMapIterator& other) const { return pos == other.pos; }
+  bool operator != (const FlatMapIterator& other) const { return pos != other.pos; }
+  bool operator < (const FlatMapIterator& other) const { return pos < other.pos; }
+  bool operator > (const FlatMapIterator& other) const { return pos > other.pos; }
+  bool operator <= (const FlatMapIterator& other) const { return pos <= other.pos; }
+  bool operator >= (const FlatMapIterator& other) const { return pos >= other.pos; }
+
+  value_type* const* pos;
+};
+
+}
+
+// An insertion ordered map. The entries live in blocks that are never moved, each new block as
+// large as the ones before it together, so references to an entry stay valid until it is
+// erased, as with std::map. Their order is kept in one contiguous table: a pointer to each
+// entry, followed by a compact array of their keys. Small maps are searched by scanning the
+// keys; once a map holds more than index_threshold entries, an open addressing index of entry
+// positions is added. Keys are unique. Inserting may move the table, invalidating iterators
+// but not references.
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Alloc = std::allocator<std::pair<const Key, T>>>
+struct FlatMap {
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<const Key, T> value_type;
+  typedef Hash hasher;
+  typedef Alloc allocator_type;
+  typedef std::size_t size_type;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+  typedef detail::FlatMapIterator<value_type> iterator;
+  typedef detail::FlatMapIterator<const value_type> const_iterator;
+
+  static const std::size_t index_threshold = 16;
+
+  FlatMap() { }
+
+  explicit FlatMap(const allocator_type& alloc_)
+    : alloc(alloc_) { }
+
+  template <typename Iterator>
+  FlatMap(Iterator first, Iterator last, const allocator_type& alloc_ = allocator_type())
+    : alloc(alloc_) {
+    insert(first, last);
+  }
+
+  FlatMap(std::initializer_list<value_type> list, const allocator_type& alloc_ = allocator_type())
+    : FlatMap(list.begin(), list.end(), alloc_) { }
+
+  FlatMap(const FlatMap& other)
+    : alloc(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc)) {
+    copy(other);
+  }
+
+  FlatMap(FlatMap&& other)
+    : alloc(other.alloc) {
+    steal(other);
+  }
+
+  ~FlatMap() {
+    release();
+  }
+
+  FlatMap& operator = (const FlatMap& other) {
+    if (this != &other) {
+      clear();
+      copy(other);
+    }
+    return *this;
+  }
+
+  // entries only change hands when both maps allocate from the same place
+  FlatMap& operator = (FlatMap&& other) {
+    if (this == &other)
+      return *this;
+
+    if (alloc == other.alloc) {
+      release();
+      steal(other);
+    }
+    else {
+      clear();
+      reserve(other.len);
+      for (auto& entry : other)
+        append(entry.first, std::move(entry.second));
+      other.clear();
+    }
+    return *this;
+  }
+
+  FlatMap& operator = (std::initializer_list<value_type> list) {
+    clear();
+    insert(list);
+    return *this;
+  }
+
+  allocator_type get_allocator() const {
+    return alloc;
+  }
+
+  iterator begin() { return iterator(entries); }
+  iterator end() { return iterator(entries + len); }
+  const_iterator begin() const { return const_iterator(entries); }
+  const_iterator end() const { return const_iterator(entries + len); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  bool empty() const {
+    return len == 0;
+  }
+
+  size_type size() const {
+    return len;
+  }
+
+  size_type capacity() const {
+    return cap;
+  }
+
+  void reserve(size_type n) {
+    if (n > cap)
+      grow(n);
+  }
+
+  // destroys the entries but keeps their storage
+  void clear() {
+    destroy();
+    release_index();
+  }
+
+  iterator find(const Key& key) {
+    return iterator(entries + position(key));
+  }
+
+  const_iterator find(const Key& key) const {
+    return const_iterator(entries + position(key));
+  }
+
+  size_type count(const Key& key) const {
+    return position(key) != len ? 1 : 0;
+  }
+
+  T& at(const Key& key) {
+    auto pos = position(key);
+    if (pos == len)
+      throw std::out_of_range("FlatMap::at");
+    return entries[pos]->second;
+  }
+
+  const T& at(const Key& key) const {
+    auto pos = position(key);
+    if (pos == len)
+      throw std::out_of_range("FlatMap::at");
+    return entries[pos]->second;
+  }
+
+  T& operator [] (const Key& key) {
+    auto pos = position(key);
+    if (pos == len)
+      append(key, T());
+    return entries[pos]->second;
+  }
+
+  // like the other inserts, leaves an existing entry for the same key untouched; a key and a
+  // value are built into the entry directly, through the allocator
+  template <typename K, typename M>
+  std::pair<iterator, bool> emplace(K&& key, M&& val) {
+    return insert_entry(static_cast<const Key&>(key), std::forward<M>(val));
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  std::pair<iterator, bool> insert(const value_type& entry) {
+    return insert_entry(entry.first, entry.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& entry) {
+    return insert_entry(entry.first, std::move(entry.second));
+  }
+
+  // the hint is ignored, new entries always go last; this is what std::inserter calls
+  iterator insert(const_iterator, const value_type& entry) {
+    return insert(entry).first;
+  }
+
+  template <typename Iterator>
+  void insert(Iterator first, Iterator last) {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  void insert(std::initializer_list<value_type> list) {
+    insert(list.begin(), list.end());
+  }
+
+  // keeps the order of the remaining entries, which stay where they are; the storage of the
+  // erased one is reused by the next insert
+  iterator erase(const_iterator itr) {
+    auto pos = static_cast<size_type>(itr.pos - entries);
+    auto freed = entries[pos];
+    freed->~value_type();
+    for (auto i = pos; i + 1 < len; ++i) {
+      entries[i] = entries[i + 1];
+      keys[i] = keys[i + 1];
+    }
+    entries[--len] = freed;
+    keys[len].~Key();
+    if (slots)
+      build_index();
+    return iterator(entries + pos);
+  }
+
+  size_type erase(const Key& key) {
+    auto pos = position(key);
+    if (pos == len)
+      return 0;
+    erase(const_iterator(entries + pos));
+    return 1;
+  }
+
+  void swap(FlatMap& other) {
+    std::swap(alloc, other.alloc);
+    std::swap(entries, other.entries);
+    std::swap(keys, other.keys);
+    std::swap(blocks, other.blocks);
+    std::swap(len, other.len);
+    std::swap(cap, other.cap);
+    std::swap(slots, other.slots);
+    std::swap(slot_count, other.slot_count);
+  }
+
+private:
+  // Heads a block of entries, which follow it in the same allocation. The first block of a map
+  // also holds its first table behind the entries, so that a small map takes one allocation;
+  // later tables are allocated on their own.
+  struct Block {
+    Block* next;
+    size_type size;
+  };
+
+  static_assert(alignof(value_type) <= alignof(Block), "entries are placed right behind a block header");
+  static_assert(alignof(Key) <= alignof(value_type*), "keys are placed right behind the entry pointers");
+
+  typedef std::allocator_traits<Alloc> traits;
+  typedef typename traits::template rebind_alloc<std::uint32_t> slot_allocator;
+  typedef typename traits::template rebind_alloc<Block> block_allocator;
+  typedef std::allocator_traits<block_allocator> block_traits;
+
+  // Block units taken by n entries, and by a header in front of them
+  static size_type block_units(size_type n) {
+    return 1 + (n * sizeof(value_type) + sizeof(Block) - 1) / sizeof(Block);
+  }
+
+  // Block units taken by a table of n entry pointers followed by n keys
+  static size_type table_units(size_type n) {
+    return (n * (sizeof(value_type*) + sizeof(Key)) + sizeof(Block) - 1) / sizeof(Block);
+  }
+
+  // the first block is the one at the end of the chain
+  static size_type units(const Block* block) {
+    return block_units(block->size) + (block->next ? 0 : table_units(block->size));
+  }
+
+  size_type position(const Key& key) const {
+    if (!slots)
+      return detail::scan_keys(keys, len, key);
+
+    auto mask = slot_count - 1;
+    for (auto i = hasher()(key) & mask;; i = (i + 1) & mask) {
+      auto slot = slots[i];
+      if (slot == 0)
+        return len;
+      if (keys[slot - 1] == key)
+        return slot - 1;
+    }
+  }
+
+  template <typename Mapped>
+  std::pair<iterator, bool> insert_entry(const Key& key, Mapped&& val) {
+    auto pos = position(key);
+    if (pos != len)
+      return std::make_pair(iterator(entries + pos), false);
+    append(key, std::forward<Mapped>(val));
+    return std::make_pair(iterator(entries + pos), true);
+  }
+
+  template <typename Mapped>
+  void append(const Key& key, Mapped&& val) {
+    if (len == cap)
+      grow(cap ? cap * 2 : 4);
+    traits::construct(alloc, entries[len], key, std::forward<Mapped>(val));
+    new (keys + len) Key(key);
+    ++len;
+
+    if (slots && len * 2 <= slot_count)
+      add_slot(len - 1);
+    else if (len > index_threshold)
+      build_index();
+  }
+
+  // the entries stay in their blocks, a new block provides the storage past cap
+  void grow(size_type n) {
+    block_allocator block_alloc(alloc);
+    Block* block;
+    value_type** table;
+    if (!blocks) {
+      block = &*block_traits::allocate(block_alloc, block_units(n) + table_units(n));
+      table = reinterpret_cast<value_type**>(block + block_units(n));
+    }
+    else {
+      table = reinterpret_cast<value_type**>(&*block_traits::allocate(block_alloc, table_units(n)));
+      try {
+        block = &*block_traits::allocate(block_alloc, block_units(n - cap));
+      }
+      catch (...) {
+        block_traits::deallocate(block_alloc, reinterpret_cast<Block*>(table), table_units(n));
+        throw;
+      }
+    }
+    new (block) Block{blocks, n - cap};
+
+    auto fresh_keys = reinterpret_cast<Key*>(table + n);
+    for (size_type i = 0; i < cap; ++i)
+      table[i] = entries[i];
+    for (size_type i = 0; i < len; ++i) {
+      new (fresh_keys + i) Key(std::move(keys[i]));
+      keys[i].~Key();
+    }
+    auto storage = reinterpret_cast<value_type*>(block + 1);
+    for (size_type i = cap; i < n; ++i)
+      table[i] = storage + (i - cap);
+
+    release_table();
+    entries = table;
+    keys = fresh_keys;
+    blocks = block;
+    cap = n;
+  }
+
+  void add_slot(size_type pos) {
+    auto mask = slot_count - 1;
+    auto i = hasher()(keys[pos]) & mask;
+    while (slots[i] != 0)
+      i = (i + 1) & mask;
+    slots[i] = static_cast<std::uint32_t>(pos + 1);
+  }
+
+  // sized for the current capacity, at most half full
+  void build_index() {
+    release_index();
+    if (len <= index_threshold)
+      return;
+
+    slot_count = 1;
+    while (slot_count < 2 * (cap > len ? cap : len))
+      slot_count *= 2;
+
+    slot_allocator slot_alloc(alloc);
+    slots = &*std::allocator_traits<slot_allocator>::allocate(slot_alloc, slot_count);
+    std::memset(slots, 0, slot_count * sizeof(std::uint32_t));
+    for (size_type i = 0; i < len; ++i)
+      add_slot(i);
+  }
+
+  void release_index() {
+    if (slots) {
+      slot_allocator slot_alloc(alloc);
+      std::allocator_traits<slot_allocator>::deallocate(slot_alloc, slots, slot_count);
+    }
+    slots = nullptr;
+    slot_count = 0;
+  }
+
+  void destroy() {
+    for (size_type i = 0; i < len; ++i) {
+      entries[i]->~value_type();
+      keys[i].~Key();
+    }
+    len = 0;
+  }
+
+  // only a table that is not the one held by the first block
+  void release_table() {
+    if (blocks && blocks->next) {
+      block_allocator block_alloc(alloc);
+      block_traits::deallocate(block_alloc, reinterpret_cast<Block*>(entries), table_units(cap));
+    }
+  }
+
+  void deallocate() {
+    release_table();
+    block_allocator block_alloc(alloc);
+    while (blocks) {
+      auto next = blocks->next;
+      block_traits::deallocate(block_alloc, blocks, units(blocks));
+      blocks = next;
+    }
+    entries = nullptr;
+    keys = nullptr;
+    cap = 0;
+  }
+
+  void release() {
+    destroy();
+    deallocate();
+    release_index();
+  }
+
+  void copy(const FlatMap& other) {
+    reserve(other.len);
+    for (const auto& entry : other)
+      append(entry.first, entry.second);
+  }
+
+  void steal(FlatMap& other) {
+    entries = other.entries;
+    keys = other.keys;
+    blocks = other.blocks;
+    len = other.len;
+    cap = other.cap;
+    slots = other.slots;
+    slot_count = other.slot_count;
+    other.entries = nullptr;
+    other.keys = nullptr;
+    other.blocks = nullptr;
+    other.len = other.cap = 0;
+    other.slots = nullptr;
+    other.slot_count = 0;
+  }
+
+  allocator_type alloc;
+  value_type** entries = nullptr;
+  Key* keys = nullptr;
+  Block* blocks = nullptr;
+  size_type len = 0;
+  size_type cap = 0;
+  std::uint32_t* slots = nullptr;
+  size_type slot_count = 0;
+};
+
+// equal when both hold the same keys with equal values, in any order
+template <typename Key, typename T, typename Hash, typename Alloc>
+bool operator == (const FlatMap<Key, T, Hash, Alloc>& left, const FlatMap<Key, T, Hash, Alloc>& right) {
+  if (left.size() != right.size())
+    return false;
+  for (const auto& entry : left) {
+    auto itr = right.find(entry.first);
+    if (itr == right.end() || !(itr->second == entry.second))
+      return false;
+  }
+  return true;
+}
+
+template <typename Key, typename T, typename Hash, typename Alloc>
+bool operator != (const FlatMap<Key, T, Hash, Alloc>& left, const FlatMap<Key, T, Hash, Alloc>& right) {
+  return !(left == right);
+}
+
+}
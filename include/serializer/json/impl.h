@@ -1,6 +1,11 @@
 #pragma once
 
 #include <serializer/json/json.h>
+#include <serializer/json/atom.h>
+#include <serializer/json/flat_map.h>
+#include <serializer/json/arena.h>
+#include <serializer/json/mapping.h>
+#include <serializer/json/blocks.h>
 
 #include <vector>
 #include <list>
@@ -9,6 +14,11 @@
 #include <set>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
@@ -17,12 +27,22 @@ namespace json {
 
 struct Value;
 typedef std::string String;
-typedef std::unordered_map<String, Value> Object;
-typedef std::vector<Value> Array;
+typedef FlatMap<Atom, Value, std::hash<Atom>, Allocator<std::pair<const Atom, Value>>> Object;
+typedef std::vector<Value, Allocator<Value>> Array;
 typedef double Number;
 typedef bool Bool;
 struct Null { };
 
+namespace detail {
+
+template <>
+struct ArenaConstruct<Value>;
+
+template <>
+struct ArenaConstruct<std::pair<const Atom, Value>>;
+
+}
+
 inline void concat_impl(std::ostream& out) {
 
 }
@@ -53,23 +73,122 @@ struct TypeException : public ExceptionBase {
   using ExceptionBase::ExceptionBase;
 };
 
+struct ParseException : public ExceptionBase {
+  using ExceptionBase::ExceptionBase;
+};
+
 struct QueryResult;
 struct SetterResult;
 
+// the characters of a string value, see Value::view()
+struct StringView {
+  const char* data;
+  std::size_t size;
+
+  std::string str() const {
+    return std::string(data, size);
+  }
+};
+
+namespace detail {
+
+// intrusively counted storage for the non-scalar value types; nodes allocated from an
+// arena are not counted and are reclaimed together with it
+template <typename T>
+struct Node {
+  template <typename... Args>
+  Node(Arena* arena_, Args&&... args) : refs(1), hash(0), arena(arena_), owned(false), value(std::forward<Args>(args)...) { }
+
+  std::atomic<std::size_t> refs;
+  // structural hash of value, 0 until computed; exposed once value was handed out for changes
+  mutable std::atomic<std::size_t> hash;
+  Arena* arena;
+  // set once value is registered to be destroyed with its arena
+  bool owned;
+  T value;
+};
+
+// marks a node whose value may be changed through a reference kept from a mutable access, at
+// any time, so its hash is never cached again
+const std::size_t exposed = ~std::size_t(0);
+
+template <typename T, typename... Args>
+Node<T>* make_node(Arena* arena, Args&&... args) {
+  if (!arena)
+    return new Node<T>(nullptr, std::forward<Args>(args)...);
+  return new (arena->allocate(sizeof(Node<T>), alignof(Node<T>))) Node<T>(arena, std::forward<Args>(args)...);
+}
+
+// arena nodes are counted too, so that copy on write knows when they are shared, but their
+// memory is only returned with the arena
+template <typename T>
+void retain(Node<T>* node) {
+  node->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+void release(Node<T>* node) {
+  if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1 && !node->arena)
+    delete node;
+}
+
+// arena nodes are never destroyed on their own, so one that is about to be changed, and may
+// then hold heap nodes or heap memory, is destroyed when its arena is cleared
+template <typename T>
+void own(Node<T>* node) {
+  if (node->arena && !node->owned) {
+    node->arena->own(&node->value);
+    node->owned = true;
+  }
+}
+
+// gives a node that other values share a heap copy of its own, before it is changed; the
+// copy shares the elements, which are copied in turn only if they are changed as well
+template <typename T>
+void make_unique(Node<T>*& node) {
+  if (node->refs.load(std::memory_order_acquire) != 1) {
+    auto copy = make_node<T>(nullptr, node->value);
+    release(node);
+    node = copy;
+  }
+  node->hash.store(exposed, std::memory_order_relaxed);
+  own(node);
+}
+
+// the node a copy of a value refers to: the same one, unless a reference handed out for changes
+// may still write to it, in which case the copy gets a heap node of its own
+template <typename T>
+Node<T>* share(Node<T>* node) {
+  if (node->hash.load(std::memory_order_relaxed) == exposed)
+    return make_node<T>(nullptr, node->value);
+  retain(node);
+  return node;
+}
+
+struct RawText;
+
+inline bool view_string(InStream& in, Value& val);
+
+// true if the string keeps its characters outside of its own footprint
+inline bool spilled(const String& str) {
+  auto begin = reinterpret_cast<const char*>(&str);
+  return str.data() < begin || str.data() >= begin + sizeof(String);
+}
+
+}
+
 struct Value {
+  // numbers and booleans are stored inline, everything else lives in a shared node
   union value_type {
-    std::shared_ptr<Null> null;
-    std::shared_ptr<Object> object;
-    std::shared_ptr<Array> array;
-    std::shared_ptr<String> string;
-    std::shared_ptr<Number> number;
-    std::shared_ptr<Bool> boolean;
-
-    value_type() : null(nullptr) { }
-    ~value_type() { }
+    Number number;
+    Bool boolean;
+    detail::Node<Object>* object;
+    detail::Node<Array>* array;
+    detail::Node<String>* string;
+    detail::Node<detail::RawText>* raw;
   };
 
-  value_type ptr;
+  value_type data = value_type();
 
   enum class Type : unsigned char {
     Object,
@@ -77,7 +196,10 @@ struct Value {
     String,
     Number,
     Boolean,
-    Null
+    Null,
+    // an Object or Array not parsed yet, or a String still in the text it was parsed from;
+    // reads see expanded(), changes expand() it first
+    Lazy
   };
 
   Type type = Type::Null;
@@ -88,17 +210,33 @@ struct Value {
     return ssi;
   }
 
+  bool parse(const char* data, std::size_t size) {
+    InStream ssi(data, size);
+    format(ssi, *this);
+    return ssi;
+  }
+
   bool parse(std::istream& in) {
     InStream ssi(in);
     format(ssi, *this);
+    if (!ssi)
+      in.setstate(std::ios_base::failbit);
     return ssi;
   }
 
+  // parses straight from a memory mapping of the file instead of reading it into a string
+  bool parse_file(const std::string& path) {
+    MappedFile file;
+    return file.open(path) && parse(file.data(), file.size());
+  }
+
   std::string json() const {
-    std::stringstream out;
-    OutStream ss(out);
-    format(ss, *this);
-    return std::move(out.str());
+    std::string res;
+    {
+      OutStream ss(res);
+      format(ss, *this);
+    }
+    return res;
   }
 
   template <typename Type>
@@ -120,44 +258,68 @@ struct Value {
   template <typename Type>
   bool is() const;
 
+  // The characters of a String. A string of a Document that is still viewed in its text is read
+  // from there without a copy, and the view is valid as long as the document is; otherwise it
+  // is valid until the string is changed. Throws TypeException for other types.
+  StringView view() const;
+
+  // true for a String still viewed in the text it was parsed from
+  bool viewed() const;
+
+  // keys that were never interned cannot be present, so queries do not intern
   bool has(const std::string& key) const {
-    return (type == Type::Object && ptr.object->find(key) != ptr.object->end());
+    auto& self = expanded();
+    Atom atom;
+    return (self.type == Type::Object && Atom::find(key, atom) && self.data.object->value.find(atom) != self.data.object->value.end());
   }
 
   bool has(const char* key) const {
-    return has(std::string(key));
+    auto& self = expanded();
+    Atom atom;
+    return (self.type == Type::Object && Atom::find(key, std::strlen(key), atom) && self.data.object->value.find(atom) != self.data.object->value.end());
   }
 
   bool has(std::size_t idx) const {
-    return (type == Type::Array && idx < ptr.array->size());
+    auto& self = expanded();
+    return (self.type == Type::Array && idx < self.data.array->value.size());
   }
 
   Value& lookup(const std::string& key) {
-    return ptr.object->operator[](key);
+    detach();
+    return data.object->value.operator[](key);
   }
 
   Value& lookup(std::size_t idx) {
-    return ptr.array->operator[](idx);
+    detach();
+    return data.array->value.operator[](idx);
   }
 
   const Value& lookup(const std::string& key) const {
-    auto itr = ptr.object->find(key);
+    auto& self = expanded();
+    Atom atom;
+    Atom::find(key, atom);
+    auto itr = self.data.object->value.find(atom);
     return itr->second;
   }
 
   const Value& lookup(std::size_t idx) const {
-    return ptr.array->operator[](idx);
+    return expanded().data.array->value.operator[](idx);
   }
 
-
+  // v is copied before this is changed, as it may be one of the elements that changing this
+  // copies or expands
   template <typename Value>
   void set(const std::string& key, const Value& v) {
-    ptr.object->operator[](key) = v;
+    json::Value val(v);
+    detach();
+    data.object->value.operator[](key) = std::move(val);
   }
 
   template <typename Value>
   void set(std::size_t idx, const Value& v) {
-    ptr.array->operator[](idx) = v;
+    json::Value val(v);
+    detach();
+    data.array->value.operator[](idx) = std::move(val);
   }
 
   template <std::size_t size>
@@ -198,7 +360,7 @@ struct Value {
   }
 
   Value(std::string&& str) {
-    *this = str;
+    *this = std::move(str);
   }
 
   Value(const std::string& str) {
@@ -218,14 +380,14 @@ struct Value {
   }
 
   Value(Array arr) {
-    *this = arr;
+    *this = std::move(arr);
   }
 
   Value(Object obj) {
-    *this = obj;
+    *this = std::move(obj);
   }
 
-  Value(std::initializer_list<std::pair<const String, Value>> pairs) {
+  Value(std::initializer_list<std::pair<const Atom, Value>> pairs) {
     *this = Object(pairs);
   }
 
@@ -233,54 +395,121 @@ struct Value {
     *this = other;
   }
 
-  Value(Value&& other) {
-    *this = other;
+  Value(Value&& other) noexcept
+    : Value(std::move(other), nullptr) { }
+
+  // moves other into storage allocated from target: nodes of target change hands, while those
+  // of another document are copied onto the heap, so they outlive it
+  Value(Value&& other, const Arena* target) noexcept {
+    if (other.arena() && other.arena() != target)
+      *this = other.deep_clone();
+    else
+      take(other);
   }
 
+  // builds an object from alternating keys and values, moving each value into place:
+  //   Value::make_object("id", 1, "tags", std::move(tags))
+  template <typename... Args>
+  static Value make_object(Args&&... args) {
+    static_assert(sizeof...(Args) % 2 == 0, "make_object takes pairs of keys and values");
+    Object obj;
+    obj.reserve(sizeof...(Args) / 2);
+    add_members(obj, std::forward<Args>(args)...);
+    return Value(std::move(obj));
+  }
+
+  template <typename... Args>
+  static Value make_array(Args&&... args) {
+    Array arr;
+    arr.reserve(sizeof...(Args));
+    add_elements(arr, std::forward<Args>(args)...);
+    return Value(std::move(arr));
+  }
+
+  // appends to an array, turning null into an empty one first
+  Value& push_back(const Value& val) {
+    return push_back(Value(val));
+  }
+
+  Value& push_back(Value&& val);
+
   ~Value() {
     cleanup();
   }
 
+  // copies share nodes until either side is changed, so cloning takes constant time, except for
+  // the nodes on the way to a reference obtained for changes, which are copied
   const Value clone() const {
+    return *this;
+  }
+
+  // Values share their nodes and copy them on write: every mutable access (lookup, set, as<>,
+  // SetterResult and Path) calls this on the way down, so an edit copies just the shared nodes
+  // on its path and drops their cached hashes. The nodes are marked exposed, as a reference
+  // obtained this way may change them later on, so later copies of the value copy them too.
+  void detach() {
+    expand();
     switch (type) {
       case Type::Object:
-        return *ptr.object;
+        detail::make_unique(data.object);
         break;
       case Type::Array:
-        return *ptr.array;
+        detail::make_unique(data.array);
         break;
       case Type::String:
-        return *ptr.string;
+        detail::make_unique(data.string);
         break;
-      case Type::Number:
-        return *ptr.number;
+      default:
         break;
-      case Type::Boolean:
-        return *ptr.boolean;
-        break;
-      default: {
+    }
+  }
 
+  // the arena this value's node was allocated from, if any
+  Arena* arena() const;
+
+  // copies the whole tree into heap owned nodes, e.g. to keep a subtree of a Document
+  Value deep_clone() const {
+    Value res;
+    auto& self = expanded();
+    switch (self.type) {
+      case Type::Object: {
+        Object obj;
+        obj.reserve(self.data.object->value.size());
+        for (const auto& p : self.data.object->value)
+          obj.emplace(p.first, p.second.deep_clone());
+        res = std::move(obj);
+        break;
+      }
+      case Type::Array: {
+        Array arr;
+        arr.reserve(self.data.array->value.size());
+        for (const auto& v : self.data.array->value)
+          arr.push_back(v.deep_clone());
+        res = std::move(arr);
+        break;
       }
+      case Type::String:
+        res = self.data.string->value;
+        break;
+      default:
+        res = self;
     }
-    return nullptr;
+    return res;
   }
 
   void cleanup() {
     switch (type) {
       case Type::Object:
-        ptr.object = nullptr;
+        detail::release(data.object);
         break;
       case Type::Array:
-        ptr.array = nullptr;
+        detail::release(data.array);
         break;
       case Type::String:
-        ptr.string = nullptr;
+        detail::release(data.string);
         break;
-      case Type::Number:
-        ptr.number = nullptr;
-        break;
-      case Type::Boolean:
-        ptr.boolean = nullptr;
+      case Type::Lazy:
+        detail::release(data.raw);
         break;
       default: {
 
@@ -289,207 +518,311 @@ struct Value {
     type = Type::Null;
   }
 
+  // containers are stored alongside their elements, i.e. in the arena their allocator uses
   Value& operator = (Object _val) {
-    ptr.object = std::make_shared<Object>(_val);
+    auto node = detail::make_node<Object>(_val.get_allocator().arena, std::move(_val));
+    cleanup();
+    data.object = node;
     type = Type::Object;
     return *this;
   }
 
   Value& operator = (Array _val) {
-    ptr.array = std::make_shared<Array>(_val);
+    auto node = detail::make_node<Array>(_val.get_allocator().arena, std::move(_val));
+    cleanup();
+    data.array = node;
     type = Type::Array;
     return *this;
   }
 
   Value& operator = (String _val) {
-    ptr.string = std::make_shared<String>(_val);
-    type = Type::String;
-    return *this;
+    return assign(nullptr, std::move(_val));
   }
 
   Value& operator = (const char* _str) {
-    ptr.string = std::make_shared<String>(_str);
+    return assign(nullptr, String(_str));
+  }
+
+  // makes this a Lazy value over the text of an array, an object or a quoted string
+  Value& assign_lazy(Arena* arena, const char* begin, const char* end);
+
+  // What a Lazy value parses into, and the value itself otherwise. The text is parsed by the
+  // first reader and kept in the node, so any number of threads may read the same value, while
+  // the value itself is left as it is.
+  const Value& expanded() const;
+
+  // replaces a Lazy value with what it parses into, before it is changed
+  void expand();
+
+  Value& assign(Arena* arena, String&& _val) {
+    auto node = detail::make_node<String>(arena, std::move(_val));
+    if (detail::spilled(node->value))
+      detail::own(node);
+    cleanup();
+    data.string = node;
     type = Type::String;
     return *this;
   }
 
   Value& operator = (Number _val) {
-    ptr.number = std::make_shared<Number>(_val);
+    cleanup();
+    data.number = _val;
     type = Type::Number;
     return *this;
   }
 
   Value& operator = (int _val) {
-    ptr.number = std::make_shared<Number>(_val);
+    cleanup();
+    data.number = _val;
     type = Type::Number;
     return *this;
   }
 
   Value& operator = (Bool _val) {
-    ptr.boolean = std::make_shared<Bool>(_val);
+    cleanup();
+    data.boolean = _val;
     type = Type::Boolean;
     return *this;
   }
 
   Value& operator = (const Null& _val) {
-    ptr.null = nullptr;
-    type = Type::Null;
+    cleanup();
     return *this;
   }
 
   Value& operator = (std::nullptr_t _val) {
-    ptr.null = nullptr;
-    type = Type::Null;
+    cleanup();
     return *this;
   }
 
-  Value& operator = (std::initializer_list<std::pair<const String, Value>> pairs) {
+  Value& operator = (std::initializer_list<std::pair<const Atom, Value>> pairs) {
     *this = Object(pairs);
     return *this;
   }
 
+  // like copies, moves out of a document copy the tree onto the heap
+  Value& operator = (Value&& other) noexcept {
+    if (this == &other)
+      return *this;
+    if (other.arena())
+      return *this = other.deep_clone();
+    return take(other);
+  }
+
+  // nodes of a document are not shared with values outside of it: copying one copies the tree
+  // onto the heap, so the copy outlives the document. Nor are nodes that were handed out for
+  // changes, see detail::share.
   Value& operator = (const Value& _val) {
     if (this == &_val)
       return *this;
+    if (_val.arena())
+      return *this = _val.deep_clone();
 
-    cleanup();
-    type = _val.type;
+    auto other_data = _val.data;
     switch (_val.type) {
       case Type::Object:
-        ptr.object = _val.ptr.object;
+        other_data.object = detail::share(_val.data.object);
         break;
       case Type::Array:
-        ptr.array = _val.ptr.array;
+        other_data.array = detail::share(_val.data.array);
         break;
       case Type::String:
-        ptr.string = _val.ptr.string;
-        break;
-      case Type::Number:
-        ptr.number = _val.ptr.number;
+        other_data.string = detail::share(_val.data.string);
         break;
-      case Type::Boolean:
-        ptr.boolean = _val.ptr.boolean;
+      case Type::Lazy:
+        detail::retain(_val.data.raw);
         break;
       default: {
 
       }
     }
+
+    cleanup();
+    data = other_data;
+    type = _val.type;
+    return *this;
+  }
+
+private:
+  // reads other before releasing the current value, which may own other
+  Value& take(Value& other) noexcept {
+    auto other_data = other.data;
+    auto other_type = other.type;
+    other.type = Type::Null;
+    cleanup();
+    data = other_data;
+    type = other_type;
     return *this;
   }
+
+  static void add_members(Object&) { }
+
+  template <typename Key, typename Val, typename... Rest>
+  static void add_members(Object& obj, Key&& key, Val&& val, Rest&&... rest) {
+    obj.emplace(std::forward<Key>(key), std::forward<Val>(val));
+    add_members(obj, std::forward<Rest>(rest)...);
+  }
+
+  static void add_elements(Array&) { }
+
+  template <typename Val, typename... Rest>
+  static void add_elements(Array& arr, Val&& val, Rest&&... rest) {
+    arr.emplace_back(std::forward<Val>(val));
+    add_elements(arr, std::forward<Rest>(rest)...);
+  }
+};
+
+static_assert(sizeof(Value) <= 16, "json::Value should stay within two words");
+
+namespace detail {
+
+// Values moved into the containers of a document keep their nodes when they come from the same
+// arena, which is how a document is built; the rest go through the public moves and copies.
+template <>
+struct ArenaConstruct<Value> {
+  static void construct(Arena* arena, Value* ptr, Value&& val) {
+    ::new (static_cast<void*>(ptr)) Value(std::move(val), arena);
+  }
+
+  template <typename... Args>
+  static void construct(Arena*, Value* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) Value(std::forward<Args>(args)...);
+  }
 };
 
+template <>
+struct ArenaConstruct<std::pair<const Atom, Value>> {
+  typedef std::pair<const Atom, Value> value_type;
+
+  static void construct(Arena* arena, value_type* ptr, const Atom& key, Value&& val) {
+    ::new (static_cast<void*>(ptr)) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::move(val), arena));
+  }
+
+  template <typename... Args>
+  static void construct(Arena*, value_type* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) value_type(std::forward<Args>(args)...);
+  }
+};
+
+}
+
 template <>
 inline bool Value::is<Object>() const {
-  return type == Type::Object;
+  return expanded().type == Type::Object;
 }
 
 template <>
 inline bool Value::is<Array>() const {
-  return type == Type::Array;
+  return expanded().type == Type::Array;
 }
 
 template <>
 inline bool Value::is<String>() const {
-  return type == Type::String;
+  return viewed() || expanded().type == Type::String;
 }
 
 template <>
 inline bool Value::is<Number>() const {
-  return type == Type::Number;
+  return expanded().type == Type::Number;
 }
 
 template <>
 inline bool Value::is<Bool>() const {
-  return type == Type::Boolean;
+  return expanded().type == Type::Boolean;
 }
 
 template <>
 inline bool Value::is<Null>() const {
-  return type == Type::Null;
+  return expanded().type == Type::Null;
 }
 
 template <>
 inline Object& Value::as_impl<Object>() {
   if (!is<Object>())
     throw TypeException("Object type assertion failed");
-  return *ptr.object;
+  detach();
+  return data.object->value;
 }
 
 template <>
 inline const Object& Value::as_impl<Object>() const {
   if (!is<Object>())
     throw TypeException("Object type assertion failed");
-  return *ptr.object;
+  return expanded().data.object->value;
 }
 
 template <>
 inline Array& Value::as_impl<Array>() {
   if (!is<Array>())
     throw TypeException("Array type assertion failed");
-  return *ptr.array;
+  detach();
+  return data.array->value;
 }
 
 template <>
 inline const Array& Value::as_impl<Array>() const {
   if (!is<Array>())
     throw TypeException("Array type assertion failed");
-  return *ptr.array;
+  return expanded().data.array->value;
 }
 
 template <>
 inline String& Value::as_impl<String>() {
   if (!is<String>())
     throw TypeException("String type assertion failed");
-  return *ptr.string;
+  detach();
+  return data.string->value;
 }
 
 template <>
 inline const String& Value::as_impl<String>() const {
   if (!is<String>())
     throw TypeException("String type assertion failed");
-  return *ptr.string;
+  return expanded().data.string->value;
 }
 
 template <>
 inline Number& Value::as_impl<Number>() {
   if (!is<Number>())
     throw TypeException("Number type assertion failed");
-  return *ptr.number;
+  return data.number;
 }
 
 template <>
 inline const Number& Value::as_impl<Number>() const {
   if (!is<Number>())
     throw TypeException("Number type assertion failed");
-  return *ptr.number;
+  return data.number;
 }
 
 template <>
 inline Bool& Value::as_impl<Bool>() {
   if (!is<Bool>())
     throw TypeException("Bool type assertion failed");
-  return *ptr.boolean;
+  return data.boolean;
 }
 
 template <>
 inline const Bool& Value::as_impl<Bool>() const {
   if (!is<Bool>())
     throw TypeException("Bool type assertion failed");
-  return *ptr.boolean;
+  return data.boolean;
 }
 
 template <>
 inline Null& Value::as_impl<Null>() {
   if (!is<Null>())
     throw TypeException("Null type assertion failed");
-  return *ptr.null;
+  static Null null;
+  return null;
 }
 
 template <>
 inline const Null& Value::as_impl<Null>() const {
   if (!is<Null>())
     throw TypeException("Null type assertion failed");
-  return *ptr.null;
+  static const Null null = Null();
+  return null;
 }
 
 template <>
@@ -502,6 +835,14 @@ inline const Value& Value::as_impl<Value>() const {
   return *this;
 }
 
+inline Value& Value::push_back(Value&& val) {
+  if (is<Null>())
+    *this = Array();
+  auto& arr = as<Array>();
+  arr.push_back(std::move(val));
+  return arr.back();
+}
+
 // TODO: should make this a union type
 struct Key {
   Key() {}
@@ -534,7 +875,7 @@ struct QueryResult {
   }
 
   QueryResult(KeyList&& keys, const Value& value)
-    : _keys(keys), _value(&value)
+    : _keys(std::move(keys)), _value(&value)
   {}
 
   QueryResult(std::size_t key, const Value& value)
@@ -641,7 +982,7 @@ struct SetterResult {
   {}
 
   SetterResult(KeyList&& keys, Value& value)
-    : _keys(keys), _value(value)
+    : _keys(std::move(keys)), _value(value)
   {}
 
   SetterResult(const std::string& key, Value& value)
@@ -656,7 +997,9 @@ struct SetterResult {
     _keys.emplace_back(key);
   }
 
+  // like Value::set, copies the value first, as it may live inside the path being created
   Value& operator = (const Value& set) {
+    Value val(set);
     Value* root = &_value;
     for (const auto& key : _keys) {
       if (key.isString) {
@@ -673,7 +1016,7 @@ struct SetterResult {
         root = &root->lookup(key.idx);
       }
     }
-    *root = set;
+    *root = std::move(val);
 
     return _value;
   }
@@ -801,39 +1144,36 @@ inline bool equivalent(const Array& v1, const Array& v2) {
   return true;
 }
 
-// TODO: improve efficiency here - currently O(n^2) for dictionary comparisons
+// members are matched by key, trying the same position first since equal documents usually
+// list their members in the same order
 inline bool equivalent(const Object& v1, const Object& v2) {
   if (v1.size() != v2.size())
     return false;
 
+  auto same = v2.begin();
   for (const auto& p1 : v1) {
-    bool key_match = false;
-    for (const auto& p2 : v2) {
-      if (p1.first == p2.first) {
-        key_match = true;
-        if (!equivalent(p1.second, p2.second))
-          return false;
-        break;
-      }
-    }
-    if (!key_match)
+    auto p2 = same->first == p1.first ? same : v2.find(p1.first);
+    if (p2 == v2.end() || !equivalent(p1.second, p2->second))
       return false;
+    ++same;
   }
 
   return true;
 }
 
-inline bool equivalent(const Value& v1, const Value& v2) {
+inline bool equivalent(const Value& lazy1, const Value& lazy2) {
+  auto& v1 = lazy1.expanded();
+  auto& v2 = lazy2.expanded();
   if (v1.type != v2.type)
     return false;
 
   switch (v1.type) {
     case Value::Type::Object:
-      return equivalent(v1.as<Object>(), v2.as<Object>());
+      return v1.data.object == v2.data.object || equivalent(v1.as<Object>(), v2.as<Object>());
     case Value::Type::Array:
-      return equivalent(v1.as<Array>(), v2.as<Array>());
+      return v1.data.array == v2.data.array || equivalent(v1.as<Array>(), v2.as<Array>());
     case Value::Type::String:
-      return equivalent(v1.as<String>(), v2.as<String>());
+      return v1.data.string == v2.data.string || equivalent(v1.as<String>(), v2.as<String>());
     case Value::Type::Number:
       return equivalent(v1.as<Number>(), v2.as<Number>());
     case Value::Type::Boolean:
@@ -844,6 +1184,190 @@ inline bool equivalent(const Value& v1, const Value& v2) {
   }
 }
 
+namespace detail {
+
+// runs work(begin, end) over slices of [0, count) on threads workers, until one returns false
+template <typename Work>
+bool parallel_for(std::size_t count, unsigned threads, Work work) {
+  std::atomic<bool> ok(true);
+  std::atomic<std::size_t> next(0);
+  auto slice = std::max<std::size_t>(count / (threads * 8), 1);
+  auto run = [&] {
+    for (auto begin = next.fetch_add(slice); begin < count; begin = next.fetch_add(slice)) {
+      if (!ok || !work(begin, std::min(count, begin + slice))) {
+        ok = false;
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(run);
+  run();
+  for (auto& thread : pool)
+    thread.join();
+  return ok;
+}
+
+// containers with fewer members are compared on the calling thread
+const std::size_t parallel_members = 1024;
+
+inline bool parallel_equivalent(const Value& lazy1, const Value& lazy2, unsigned threads) {
+  auto& v1 = lazy1.expanded();
+  auto& v2 = lazy2.expanded();
+  if (v1.type != v2.type)
+    return false;
+
+  if (v1.type == Value::Type::Array && v1.data.array != v2.data.array) {
+    const auto& a1 = v1.data.array->value;
+    const auto& a2 = v2.data.array->value;
+    if (a1.size() != a2.size())
+      return false;
+    if (a1.size() >= parallel_members) {
+      return parallel_for(a1.size(), threads, [&](std::size_t begin, std::size_t end) -> bool {
+        for (auto i = begin; i < end; ++i) {
+          if (!equivalent(a1[i], a2[i]))
+            return false;
+        }
+        return true;
+      });
+    }
+    for (std::size_t i = 0; i < a1.size(); ++i) {
+      if (!parallel_equivalent(a1[i], a2[i], threads))
+        return false;
+    }
+    return true;
+  }
+
+  if (v1.type == Value::Type::Object && v1.data.object != v2.data.object) {
+    const auto& o1 = v1.data.object->value;
+    const auto& o2 = v2.data.object->value;
+    if (o1.size() != o2.size())
+      return false;
+    auto match = [&](std::size_t i) -> bool {
+      const auto& p1 = o1.begin()[i];
+      auto p2 = o2.begin() + i;
+      if (p2->first != p1.first)
+        p2 = o2.find(p1.first);
+      return p2 != o2.end() && (o1.size() >= parallel_members ? equivalent(p1.second, p2->second) : parallel_equivalent(p1.second, p2->second, threads));
+    };
+    if (o1.size() >= parallel_members) {
+      return parallel_for(o1.size(), threads, [&](std::size_t begin, std::size_t end) -> bool {
+        for (auto i = begin; i < end; ++i) {
+          if (!match(i))
+            return false;
+        }
+        return true;
+      });
+    }
+    for (std::size_t i = 0; i < o1.size(); ++i) {
+      if (!match(i))
+        return false;
+    }
+    return true;
+  }
+
+  return equivalent(v1, v2);
+}
+
+}
+
+// Same as equivalent, but the members of arrays and objects with at least 1024 of them are
+// compared on threads workers (0 picks one per core). Lazy values are parsed as the workers
+// reach them.
+inline bool parallel_equivalent(const Value& v1, const Value& v2, unsigned threads = 0) {
+  if (threads == 0)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  return threads == 1 ? equivalent(v1, v2) : detail::parallel_equivalent(v1, v2, threads);
+}
+
+namespace detail {
+
+inline std::size_t mix_hash(std::uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return static_cast<std::size_t>(h);
+}
+
+template <typename T>
+std::size_t cached_hash(const Node<T>* node) {
+  auto res = node->hash.load(std::memory_order_relaxed);
+  return res != exposed ? res : 0;
+}
+
+// 0 and exposed are taken. The hash is only cached if neither the node nor anything below it
+// is exposed; otherwise cacheable is cleared, so the nodes above do not cache theirs either.
+template <typename T>
+std::size_t store_hash(const Node<T>* node, std::uint64_t h, bool members_cacheable, bool& cacheable) {
+  auto res = mix_hash(h);
+  res = res && res != exposed ? res : 1;
+  if (members_cacheable && node->hash.load(std::memory_order_relaxed) != exposed)
+    node->hash.store(res, std::memory_order_relaxed);
+  else
+    cacheable = false;
+  return res;
+}
+
+inline std::size_t hash_value(const Value& lazy, bool& cacheable) {
+  auto& value = lazy.expanded();
+  switch (value.type) {
+    case Value::Type::Object: {
+      auto node = value.data.object;
+      if (auto res = cached_hash(node))
+        return res;
+      // members are summed, which does not depend on their order
+      bool members = true;
+      std::uint64_t sum = 0;
+      for (const auto& member : node->value)
+        sum += mix_hash(member.first.hash() ^ (std::uint64_t(hash_value(member.second, members)) * 0x9e3779b97f4a7c15ull));
+      return store_hash(node, sum ^ (node->value.size() * 0x0b1ec7ull), members, cacheable);
+    }
+    case Value::Type::Array: {
+      auto node = value.data.array;
+      if (auto res = cached_hash(node))
+        return res;
+      bool elements = true;
+      std::uint64_t h = 0xa77a4ull + node->value.size();
+      for (const auto& element : node->value)
+        h = (h ^ hash_value(element, elements)) * 0x100000001b3ull;
+      return store_hash(node, h, elements, cacheable);
+    }
+    case Value::Type::String: {
+      auto node = value.data.string;
+      if (auto res = cached_hash(node))
+        return res;
+      return store_hash(node, hash_bytes(node->value.data(), node->value.size()) ^ 0x5791ull, true, cacheable);
+    }
+    case Value::Type::Number: {
+      // 0.0 and -0.0 are equal
+      auto num = value.data.number == 0 ? 0.0 : value.data.number;
+      std::uint64_t bits;
+      std::memcpy(&bits, &num, sizeof(bits));
+      return mix_hash(bits ^ 0x6e756dull);
+    }
+    case Value::Type::Boolean:
+      return mix_hash(value.data.boolean ? 0x7e5ull : 0xfa15eull);
+    default:
+      return mix_hash(0x6e01ull);
+  }
+}
+
+}
+
+// Structural hash of a value, consistent with equivalent: equal values hash equally, whatever
+// the order of their object members. Each container and string caches its hash in its node.
+// Nodes that were accessed for changes, e.g. through a non-const as<Object>() or lookup(), may
+// still be changed through the reference handed out, so they and the nodes above them are
+// hashed anew every time; untouched subtrees keep their cached hashes.
+inline std::size_t hash(const Value& value) {
+  bool cacheable = true;
+  return detail::hash_value(value, cacheable);
+}
+
 inline bool operator == (const Value& left, const Value& right) {
   return equivalent(left, right);
 };
@@ -865,8 +1389,7 @@ inline std::ostream& operator << (std::ostream& out, const Value& v) {
 }
 
 inline std::istream& operator >> (std::istream& in, Value& v) {
-  InStream ssi(in);
-  format(ssi, v);
+  v.parse(in);
   return in;
 }
 
@@ -895,26 +1418,36 @@ inline std::ostream& operator << (std::ostream& out, const Null& n) {
 template <>
 struct format_override<json::Value, json::OutStream> {
   template <typename Stream>
-  static void format(Stream& out, const json::Value& value) {
+  static void format(Stream& out, const json::Value& lazy) {
     using namespace json;
 
+    // viewed strings are escaped straight from their text
+    if (lazy.viewed()) {
+      auto str = lazy.view();
+      out.write("\"", 1);
+      escaper::escape([&](const char* chunk, std::size_t len) { out.write(chunk, len); }, str.data, str.size);
+      out.write("\"", 1);
+      return;
+    }
+
+    auto& value = lazy.expanded();
     switch(value.type) {
       case Value::Type::Object:
-        ::format(out, *value.ptr.object);
+        ::format(out, value.data.object->value);
         break;
       case Value::Type::Array:
-        ::format(out, *value.ptr.array);
+        ::format(out, value.data.array->value);
         break;
       case Value::Type::String:
-        ::format(out, *value.ptr.string);
+        ::format(out, value.data.string->value);
         break;
       case Value::Type::Number:
-        ::format(out, *value.ptr.number);
+        ::format(out, value.data.number);
         break;
       case Value::Type::Boolean:
-        ::format(out, *value.ptr.boolean);
+        ::format(out, value.data.boolean);
         break;
-      case Value::Type::Null:
+      default:
         ::format(out, Null());
         break;
     }
@@ -923,60 +1456,294 @@ struct format_override<json::Value, json::OutStream> {
 
 template <>
 struct format_override<json::Value, json::InStream> {
+  // mirrors formatter<U, json::InStream> for the json types, but allocates from the stream's arena
   template <typename Stream>
-  static void format(Stream& in, json::Value& value) {
+  static bool format_object(Stream& in, json::Object& obj) {
     using namespace json;
 
-    in.good();
-    String s;
-    ::format(in, s);
-    if (in) {
-      value = s;
-      return;
+    if (!(in.trim('{')))
+      return false;
+
+    do {
+      Atom key;
+      Value val;
+      ::format(in, key);
+      in.trim(':');
+      ::format(in, val);
+
+      if (!in)
+        break;
+
+      obj.emplace(key, std::move(val));
     }
+    while (in.trim(','));
 
     in.good();
-    Number n;
-    ::format(in, n);
-    if (in) {
-      value = n;
-      return;
+    in.trim('}');
+    return in;
+  }
+
+  template <typename Stream>
+  static bool format_array(Stream& in, json::Array& arr) {
+    using namespace json;
+
+    if (!(in.trim('[')))
+      return false;
+
+    do {
+      Value val;
+      ::format(in, val);
+      if (in)
+        arr.push_back(std::move(val));
     }
+    while (in.trim(','));
 
     in.good();
-    Bool b;
-    ::format(in, b);
-    if (in) {
-      value = b;
-      return;
-    }
+    in.trim(']');
+    return in;
+  }
+
+  // dispatches on the first significant character, so each value is read exactly once
+  template <typename Stream>
+  static void format(Stream& in, json::Value& value) {
+    using namespace json;
 
     in.good();
-    Null nu;
-    ::format(in, nu);
-    if (in) {
-      value = nu;
-      return;
+    switch (in.peek()) {
+      case '"': {
+        if (in.views && detail::view_string(in, value))
+          return;
+        String s;
+        ::format(in, s);
+        if (in)
+          value.assign(in.arena, std::move(s));
+        return;
+      }
+      case '{': {
+        Object ob(Object::allocator_type(in.arena));
+        if (format_object(in, ob))
+          value = std::move(ob);
+        return;
+      }
+      case '[': {
+        Array ar(Array::allocator_type(in.arena));
+        if (format_array(in, ar))
+          value = std::move(ar);
+        return;
+      }
+      case 't':
+      case 'f': {
+        Bool b;
+        ::format(in, b);
+        if (in)
+          value = b;
+        return;
+      }
+      case 'n': {
+        Null nu;
+        ::format(in, nu);
+        if (in)
+          value = nu;
+        return;
+      }
+      case ']':
+      case '}':
+      case ',':
+      case ':':
+      case std::char_traits<char>::eof():
+        in.bad();
+        return;
+      default: {
+        Number n;
+        ::format(in, n);
+        if (in)
+          value = n;
+        return;
+      }
     }
+  }
+};
 
-    in.good();
-    Object ob;
-    ::format(in, ob);
-    if (in) {
-      value = std::move(ob);
+namespace json {
+
+namespace detail {
+
+// unparsed text of an array or object, see LazyDocument, or a quoted string without escapes,
+// see Document::open; the value parsed from it is kept here
+struct RawText {
+  RawText(const char* begin_, const char* end_)
+    : begin(begin_), end(end_) { }
+
+  const char* begin;
+  const char* end;
+  std::once_flag once;
+  Value parsed;
+};
+
+// reads one member of a lazy container; nested containers are skipped over and stay Lazy
+inline bool lazy_element(InStream& in, Value& val) {
+  auto c = in.peek();
+  if (c == '{' || c == '[') {
+    auto end = skip_container(in.cur, in.end);
+    if (!end)
+      return false;
+    val.assign_lazy(in.arena, in.cur, end);
+    in.cur = end;
+    return true;
+  }
+  ::format(in, val);
+  return in;
+}
+
+// Reads a string at in as a Lazy value viewing its text, if it has no escapes and is too long
+// for the inline buffer of a String; a copy of a shorter one takes no more room than a view.
+inline bool view_string(InStream& in, Value& val) {
+  static const std::size_t inline_capacity = String().capacity();
+
+  if (!in.contiguous())
+    return false;
+  auto begin = in.cur + 1;
+  auto close = find_quote(begin, in.end);
+  if (close == in.end || *close != '"' || static_cast<std::size_t>(close - begin) <= inline_capacity)
+    return false;
+
+  val.assign_lazy(in.arena, in.cur, close + 1);
+  in.cur = close + 1;
+  return true;
+}
+
+// parses the direct members of raw into res, allocating from arena
+inline void parse_lazy(const RawText& raw, Arena* arena, Value& res) {
+  if (*raw.begin == '"') {
+    res.assign(arena, String(raw.begin + 1, raw.end - 1));
+    return;
+  }
+
+  InStream in(raw.begin, static_cast<std::size_t>(raw.end - raw.begin));
+  in.arena = arena;
+
+  if (*raw.begin == '{') {
+    Object obj((Object::allocator_type(arena)));
+    in >> '{';
+    if (in.peek() != '}') {
+      do {
+        Atom key;
+        Value val;
+        in.peek();
+        ::format(in, key);
+        if (!in.trim(':') || !lazy_element(in, val))
+          break;
+
+        obj.emplace(key, std::move(val));
+      }
+      while (in.peek() == ',' && in >> ',');
+    }
+    if (in >> '}' && in.peek() == InStream::traits::eof()) {
+      res = std::move(obj);
       return;
     }
-
-    in.good();
-    Array ar;
-    ::format(in, ar);
-    if (in) {
-      value = std::move(ar);
+  }
+  else {
+    Array arr((Array::allocator_type(arena)));
+    in >> '[';
+    if (in.peek() != ']') {
+      do {
+        Value val;
+        if (!lazy_element(in, val))
+          break;
+        arr.push_back(std::move(val));
+      }
+      while (in.peek() == ',' && in >> ',');
+    }
+    if (in >> ']' && in.peek() == InStream::traits::eof()) {
+      res = std::move(arr);
       return;
     }
   }
+
+  throw ParseException("Malformed json: ", std::string(raw.begin, std::min<std::size_t>(raw.end - raw.begin, 64)));
+}
+
+}
+
+inline Arena* Value::arena() const {
+  switch (type) {
+    case Type::Object:
+      return data.object->arena;
+    case Type::Array:
+      return data.array->arena;
+    case Type::String:
+      return data.string->arena;
+    case Type::Lazy:
+      return data.raw->arena;
+    default:
+      return nullptr;
+  }
+}
+
+inline bool Value::viewed() const {
+  return type == Type::Lazy && *data.raw->value.begin == '"';
+}
+
+inline StringView Value::view() const {
+  if (viewed())
+    return StringView{data.raw->value.begin + 1, static_cast<std::size_t>(data.raw->value.end - data.raw->value.begin - 2)};
+  auto& str = as<String>();
+  return StringView{str.data(), str.size()};
+}
+
+inline Value& Value::assign_lazy(Arena* arena, const char* begin, const char* end) {
+  auto node = detail::make_node<detail::RawText>(arena, begin, end);
+  cleanup();
+  data.raw = node;
+  type = Type::Lazy;
+  return *this;
+}
+
+// A syntax error leaves the node unparsed, so every read throws again. Readers of different
+// nodes of one document allocate from its arena at the same time, which its mutex serializes.
+inline const Value& Value::expanded() const {
+  if (type != Type::Lazy)
+    return *this;
+
+  auto node = data.raw;
+  std::call_once(node->value.once, [node] {
+    std::unique_lock<std::mutex> lock;
+    if (node->arena)
+      lock = std::unique_lock<std::mutex>(node->arena->mutex);
+    detail::parse_lazy(node->value, node->arena, node->value.parsed);
+  });
+  return node->value.parsed;
+}
+
+// nodes of a document are never shared (copies of them are deep), so the parsed value is moved
+// out of one; a heap node another value still reads is copied from
+inline void Value::expand() {
+  if (type != Type::Lazy)
+    return;
+
+  auto& parsed = const_cast<Value&>(expanded());
+  Value res;
+  if (data.raw->refs.load(std::memory_order_acquire) == 1)
+    res.take(parsed);
+  else
+    res = parsed;
+  take(res);
+}
+
+}
+
+namespace std {
+
+template <>
+struct hash<json::Value> {
+  std::size_t operator () (const json::Value& value) const {
+    return json::hash(value);
+  }
 };
 
+}
+
 template <>
 struct has_key<json::Value> {
   typedef void key_type;
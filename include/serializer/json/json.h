@@ -1,11 +1,26 @@
 #pragma once
 
 #include <serializer/core.h>
+#include <serializer/string_escaper.h>
+#include <serializer/json/number.h>
 #include <iterator>
 #include <ostream>
-#include <iomanip>
+#include <sstream>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
 #include <istream>
 #include <limits>
+#include <cmath>
+#include <type_traits>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace json {
 
@@ -18,135 +33,622 @@ struct LiteralWrapper {
   std::size_t size;
 };
 
+// Serializes into a contiguous buffer owned by the stream. Small writes are plain memcpys; the
+// buffer is handed to the sink whenever it fills up, on flush() and on destruction. When writing
+// into a std::string the string's own storage is the buffer, so nothing is copied at the end,
+// but the string only holds the finished text once the stream is flushed or destroyed. A
+// std::ostream buffers on its own, so it is written to directly and sees every write at once.
 struct OutStream {
-  OutStream() : buffer(std::cout) { }
-  OutStream(std::ostream& buffer_) : buffer(buffer_) { }
+  typedef std::function<void(const char*, std::size_t)> Sink;
+
+  static const std::size_t buffer_size = 64 * 1024;
+  // room for the numbers formatted in place when writing to a std::ostream
+  static const std::size_t scratch_size = 64;
+
+  OutStream() : OutStream(std::cout) { }
+
+  OutStream(std::ostream& out)
+    : stream(&out), storage(new char[scratch_size]) {
+    begin = cur = storage.get();
+    end = begin + scratch_size;
+  }
+
+  OutStream(std::string& out)
+    : string(&out) {
+    begin = &out[0];
+    cur = end = begin + out.size();
+  }
+
+  // writes to a file descriptor, retrying short writes
+  explicit OutStream(int fd)
+    : OutStream(Sink([fd](const char* str, std::size_t len) { write_fd(fd, str, len); })) { }
+
+  explicit OutStream(Sink sink_)
+    : sink(std::move(sink_)), storage(new char[buffer_size]) {
+    begin = cur = storage.get();
+    end = begin + buffer_size;
+  }
+
+  OutStream(const OutStream&) = delete;
+  OutStream& operator = (const OutStream&) = delete;
 
-  std::ostream& buffer;
+  ~OutStream() {
+    flush();
+  }
+
+  void write(const char* str, std::size_t len) {
+    if (stream) {
+      stream->write(str, static_cast<std::streamsize>(len));
+      return;
+    }
+    if (static_cast<std::size_t>(end - cur) < len) {
+      if (!string) {
+        flush();
+        // too big to be worth buffering
+        if (len >= buffer_size) {
+          sink(str, len);
+          return;
+        }
+      }
+      else {
+        grow(len);
+      }
+    }
+    std::memcpy(cur, str, len);
+    cur += len;
+  }
+
+  void put(char c) {
+    if (stream) {
+      stream->put(c);
+      return;
+    }
+    if (cur == end)
+      reserve(1);
+    *cur++ = c;
+  }
+
+  // Makes room for at least len characters at the write position and returns it, for writers
+  // that format in place; commit() then advances past what they wrote.
+  char* reserve(std::size_t len) {
+    if (static_cast<std::size_t>(end - cur) < len) {
+      if (string)
+        grow(len);
+      else
+        flush();
+    }
+    return cur;
+  }
+
+  void commit(char* pos) {
+    cur = pos;
+    if (stream)
+      flush();
+  }
+
+  void flush() {
+    if (stream) {
+      if (cur != begin)
+        stream->write(begin, cur - begin);
+      cur = begin;
+    }
+    else if (string) {
+      // shrinking never reallocates, so the pointers stay valid
+      string->resize(static_cast<std::size_t>(cur - begin));
+      end = cur;
+    }
+    else if (cur != begin) {
+      sink(begin, static_cast<std::size_t>(cur - begin));
+      cur = begin;
+    }
+  }
+
+private:
+  void grow(std::size_t len) {
+    auto used = static_cast<std::size_t>(cur - begin);
+    string->resize(std::max(std::max(used * 2, used + len), std::size_t(256)));
+    begin = &(*string)[0];
+    cur = begin + used;
+    end = begin + string->size();
+  }
+
+  static void write_fd(int fd, const char* str, std::size_t len) {
+    while (len) {
+#if defined(_WIN32)
+      auto res = ::_write(fd, str, static_cast<unsigned>(len));
+#else
+      auto res = ::write(fd, str, len);
+#endif
+      if (res < 0) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      str += res;
+      len -= static_cast<std::size_t>(res);
+    }
+  }
+
+  std::string* string = nullptr;
+  std::ostream* stream = nullptr;
+  Sink sink;
+  std::unique_ptr<char[]> storage;
+  char* begin = nullptr;
+  char* cur = nullptr;
+  char* end = nullptr;
 };
 
+inline OutStream& operator << (OutStream& out, const char* str) {
+  out.write(str, std::strlen(str));
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, const std::string& str) {
+  out.write(str.data(), str.size());
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, char c) {
+  out.put(c);
+  return out;
+}
+
+namespace detail {
+
+template <typename T>
+struct out_integer : std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+  !std::is_same<T, char>::value && !std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value> { };
+
+}
+
 template <typename T>
-OutStream& operator << (OutStream& out, const T& obj) {
-  out.buffer << obj;
+auto operator << (OutStream& out, const T& val) -> typename std::enable_if<detail::out_integer<T>::value && std::is_signed<T>::value, OutStream&>::type {
+  auto pos = out.reserve(24);
+  out.commit(pos + detail::write_integer(static_cast<std::int64_t>(val), pos));
+  return out;
+}
+
+template <typename T>
+auto operator << (OutStream& out, const T& val) -> typename std::enable_if<detail::out_integer<T>::value && std::is_unsigned<T>::value, OutStream&>::type {
+  auto pos = out.reserve(24);
+  out.commit(pos + detail::write_digits(static_cast<std::uint64_t>(val), pos));
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, double val) {
+  if (!std::isfinite(val))
+    return out << "null";
+  auto pos = out.reserve(32);
+  out.commit(pos + write_number(val, pos));
   return out;
 }
 
+// anything else goes through its std::ostream operator
+template <typename T>
+auto operator << (OutStream& out, const T& obj) -> typename std::enable_if<!detail::out_integer<T>::value, OutStream&>::type {
+  std::ostringstream str;
+  str << obj;
+  return out << str.str();
+}
+
+struct Arena;
+
+inline bool is_space(int c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+}
+
+// Reads either from a contiguous [cur, end) range, in which case every primitive is plain
+// pointer arithmetic, or from a std::istream through its streambuf when stream is set.
 struct InStream {
-  std::istringstream input_stream;
-  std::istream& buffer;
+  typedef std::char_traits<char> traits;
+
+  std::string storage;
+  std::istream* stream = nullptr;
+  const char* cur = nullptr;
+  const char* end = nullptr;
+  bool state = true;
+
+  // when set, parsed json::Values are allocated from this arena
+  Arena* arena = nullptr;
+
+  // when set, long strings without escapes are read as views into the input rather than copied,
+  // so the input must live as long as the arena; see Document::open
+  bool views = false;
 
-  operator bool() { return static_cast<bool>(buffer); }
-  void good() { buffer.clear(); }
-  void bad() { buffer.setstate(std::ios_base::badbit); }
+  operator bool() const { return state; }
+  void good() { state = true; }
+  void bad() { state = false; }
+
+  bool contiguous() const { return stream == nullptr; }
+
+  int get() {
+    if (contiguous())
+      return cur != end ? traits::to_int_type(*cur++) : traits::eof();
+    return stream->rdbuf()->sbumpc();
+  }
+
+  void unget() {
+    if (contiguous())
+      --cur;
+    else
+      stream->rdbuf()->sungetc();
+  }
+
+  void skip_ws() {
+    if (contiguous()) {
+      while (cur != end && is_space(*cur))
+        ++cur;
+      return;
+    }
+    auto buf = stream->rdbuf();
+    while (is_space(buf->sgetc()))
+      buf->sbumpc();
+  }
+
+  // skips whitespace and returns the next character without consuming it
+  int peek() {
+    skip_ws();
+    if (contiguous())
+      return cur != end ? traits::to_int_type(*cur) : traits::eof();
+    return stream->rdbuf()->sgetc();
+  }
 
   template <typename T>
   InStream& trim(T&& obj) {
-    buffer >> std::ws;
+    skip_ws();
     *this >> obj;
-    buffer >> std::ws;
+    skip_ws();
     return *this;
   }
 
   std::string remaining() {
-    auto pos = buffer.tellg();
+    if (contiguous())
+      return std::string(cur, end);
+
+    auto pos = stream->tellg();
     std::stringstream str;
-    str << buffer.rdbuf();
-    buffer.good();
-    buffer.seekg(pos, buffer.beg);
+    str << stream->rdbuf();
+    stream->clear();
+    stream->seekg(pos, stream->beg);
     return str.str();
   }
 
-  InStream(const std::string& contents) : input_stream(contents), buffer(input_stream) { }
-  InStream(std::istream& input) : buffer(input) {}
+  InStream(const char* data, std::size_t size) : cur(data), end(data + size) { }
+  InStream(const char* str) : InStream(str, std::strlen(str)) { }
+  InStream(const std::string& contents) : InStream(contents.data(), contents.size()) { }
+  InStream(std::string&& contents) : storage(std::move(contents)), cur(storage.data()), end(cur + storage.size()) { }
+  InStream(std::istream& input) : stream(&input) { }
+
+  InStream(const InStream&) = delete;
+  InStream& operator = (const InStream&) = delete;
+};
+
+namespace detail {
+
+inline bool is_number_char(int c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// arithmetic types that are read as json numbers rather than through std::istream
+template <typename T>
+struct json_number {
+  const static bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+                            !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+                            !std::is_same<T, unsigned char>::value;
 };
 
 template <typename T>
-InStream& operator >> (InStream& in, T& obj) {
-  auto pos = in.buffer.tellg();
-  in.buffer >> obj;
-  if (!in) {
-    in.good();
-    in.buffer.seekg(pos);
+auto read(InStream& in, T& obj) -> typename std::enable_if<json_number<T>::value>::type {
+  in.skip_ws();
+  if (in.contiguous()) {
+    auto last = read_number(in.cur, in.end, obj);
+    if (last)
+      in.cur = last;
+    else
+      in.bad();
+    return;
+  }
+
+  auto buf = in.stream->rdbuf();
+  std::string token;
+  for (auto c = buf->sgetc(); is_number_char(c); c = buf->snextc())
+    token += InStream::traits::to_char_type(c);
+
+  auto last = read_number(token.data(), token.data() + token.size(), obj);
+  auto unused = last ? token.data() + token.size() - last : token.size();
+  for (; unused > 0; --unused)
+    buf->sungetc();
+  if (!last)
+    in.bad();
+}
+
+// anything outside of the json grammar goes through std::istream
+template <typename T>
+auto read(InStream& in, T& obj) -> typename std::enable_if<!json_number<T>::value>::type {
+  if (!in.contiguous()) {
+    auto pos = in.stream->tellg();
+    *in.stream >> obj;
+    if (!*in.stream) {
+      in.stream->clear();
+      in.stream->seekg(pos);
+      in.bad();
+    }
+    return;
+  }
+
+  // only the token is copied, up to the delimiter that ends it, rather than the rest of the
+  // input, which would make reading many such values quadratic
+  auto last = in.cur;
+  while (last != in.end && is_space(*last))
+    ++last;
+  while (last != in.end && *last != ',' && *last != ']' && *last != '}' && !is_space(*last))
+    ++last;
+
+  std::istringstream str(std::string(in.cur, last));
+  str >> obj;
+  if (!str) {
     in.bad();
+    return;
   }
+
+  if (str.eof())
+    in.cur = last;
+  else
+    in.cur += static_cast<std::size_t>(str.tellg());
+}
+
+}
+
+template <typename T>
+InStream& operator >> (InStream& in, T& obj) {
+  if (in)
+    detail::read(in, obj);
   return in;
 }
 
-inline InStream& operator >> (InStream& in, std::string& obj) {
-  bool escape = false;
-  char c = in.buffer.get();
-  while (in) {
-    if (!escape && c == '"') {
-      in.buffer.putback(c);
-      break;
+namespace detail {
+
+// returns the first '"' or '\\' in [itr, end), or end
+inline const char* find_quote(const char* itr, const char* end) {
+#if defined(__AVX2__)
+  {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    for (; end - itr >= 32; itr += 32) {
+      auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(itr));
+      auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash))));
+      if (mask)
+        return itr + escaper::first_bit(mask);
     }
-    obj += c;
-    escape = (c == '\\' && !escape);
-    c = in.buffer.get();
   }
-  return in;
+#endif
+#if defined(__SSE2__)
+  {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; end - itr >= 16; itr += 16) {
+      auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(itr));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+      if (mask)
+        return itr + escaper::first_bit(mask);
+    }
+  }
+#endif
+  while (itr != end && *itr != '"' && *itr != '\\')
+    ++itr;
+  return itr;
 }
 
-inline InStream& operator >> (InStream& in, const char* str) {
-  char buf[4096];
+inline long hex_digit(int c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
 
-  auto len = std::strlen(str);
-  auto count = in.buffer.readsome(&buf[0], len);
+template <typename Next>
+long read_hex4(Next& next) {
+  long res = 0;
+  for (int i = 0; i < 4; ++i) {
+    auto digit = hex_digit(next());
+    if (digit < 0)
+      return -1;
+    res = (res << 4) | digit;
+  }
+  return res;
+}
 
-  buf[count] = '\0';
+// decodes the escape sequence after a backslash into a code point, or -1 if it is malformed;
+// next() yields the following input characters
+template <typename Next>
+long read_escape(Next&& next) {
+  switch (next()) {
+    case '"': return '"';
+    case '\\': return '\\';
+    case '/': return '/';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'u': {
+      auto cp = read_hex4(next);
+      if (cp >= 0xDC00 && cp <= 0xDFFF)
+        return -1;
+      if (cp < 0xD800 || cp > 0xDBFF)
+        return cp;
+
+      if (next() != '\\' || next() != 'u')
+        return -1;
+      auto low = read_hex4(next);
+      if (low < 0xDC00 || low > 0xDFFF)
+        return -1;
+      return 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+    }
+    default:
+      return -1;
+  }
+}
 
-  if (count != len) {
-    for (auto c = count - 1; c >= 0; --c)
-      in.buffer.putback(buf[c]);
-    in.bad();
-    return in;
+inline std::size_t write_utf8(long cp, char* out) {
+  if (cp < 0x80) {
+    out[0] = static_cast<char>(cp);
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = static_cast<char>(0xC0 | (cp >> 6));
+    out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 2;
   }
+  if (cp < 0x10000) {
+    out[0] = static_cast<char>(0xE0 | (cp >> 12));
+    out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (cp >> 18));
+  out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+  return 4;
+}
 
-  for (auto idx = 0u; idx < count; ++idx) {
-    if (buf[idx] != str[idx]) {
-      for (auto c = count - 1; c >= 0; --c)
-        in.buffer.putback(buf[c]);
-      in.bad();
+}
+
+// reads and unescapes a string body, stopping in front of the closing quote
+inline InStream& operator >> (InStream& in, std::string& obj) {
+  if (!in)
+    return in;
+
+  if (in.contiguous()) {
+    // locate the closing quote first, so the result is sized once
+    auto close = in.cur;
+    bool escaped = false;
+    for (;;) {
+      close = detail::find_quote(close, in.end);
+      if (close == in.end) {
+        in.bad();
+        return in;
+      }
+      if (*close == '"')
+        break;
+      if (in.end - close < 2) {
+        in.bad();
+        return in;
+      }
+      escaped = true;
+      close += 2;
+    }
+
+    if (!escaped) {
+      obj.append(in.cur, close);
+      in.cur = close;
       return in;
     }
+
+    // unescaped text is never longer than its escaped form
+    auto offset = obj.size();
+    obj.resize(offset + (close - in.cur));
+    auto out = &obj[offset];
+    auto src = in.cur;
+    for (;;) {
+      auto next = detail::find_quote(src, close);
+      std::memcpy(out, src, next - src);
+      out += next - src;
+      if (next == close)
+        break;
+
+      src = next + 1;
+      auto cp = detail::read_escape([&]() -> int { return src != close ? InStream::traits::to_int_type(*src++) : InStream::traits::eof(); });
+      if (cp < 0) {
+        obj.resize(offset);
+        in.bad();
+        return in;
+      }
+      out += detail::write_utf8(cp, out);
+    }
+
+    obj.resize(out - obj.data());
+    in.cur = close;
+    return in;
   }
 
+  auto c = in.get();
+  while (c != InStream::traits::eof()) {
+    if (c == '"') {
+      in.unget();
+      return in;
+    }
+
+    if (c == '\\') {
+      auto cp = detail::read_escape([&]() { return in.get(); });
+      if (cp < 0)
+        break;
+      char buf[4];
+      obj.append(buf, detail::write_utf8(cp, buf));
+    }
+    else {
+      obj += InStream::traits::to_char_type(c);
+    }
+    c = in.get();
+  }
+  in.bad();
   return in;
 }
 
-inline InStream& operator >> (InStream& in, char c) {
-  auto n = in.buffer.get();
-  if (n == c) {
+inline InStream& match(InStream& in, const char* str, std::size_t len) {
+  if (!in)
+    return in;
+
+  if (in.contiguous()) {
+    if (static_cast<std::size_t>(in.end - in.cur) >= len && std::memcmp(in.cur, str, len) == 0)
+      in.cur += len;
+    else
+      in.bad();
     return in;
   }
-  in.buffer.putback(n);
+
+  auto buf = in.stream->rdbuf();
+  std::size_t count = 0;
+  for (; count < len && buf->sgetc() == InStream::traits::to_int_type(str[count]); ++count)
+    buf->sbumpc();
+
+  if (count == len)
+    return in;
+
+  for (; count > 0; --count)
+    buf->sungetc();
   in.bad();
   return in;
 }
 
-inline InStream& operator >> (InStream& in, const LiteralWrapper& lit) {
-  char buf[4096];
-  auto count = in.buffer.readsome(&buf[0], lit.size);
+inline InStream& operator >> (InStream& in, const char* str) {
+  return match(in, str, std::strlen(str));
+}
 
-  if (count != lit.size) {
-    for (auto c = count - 1; c >= 0; --c)
-      in.buffer.putback(buf[c]);
-    in.bad();
+inline InStream& operator >> (InStream& in, char c) {
+  if (!in)
     return in;
-  }
 
-  for (auto idx = 0u; idx < count; ++idx) {
-    if (buf[idx] != lit.str[idx]) {
-      for (auto c = count - 1; c >= 0; --c)
-        in.buffer.putback(buf[c]);
-      in.bad();
-      return in;
-    }
-  }
+  auto n = in.get();
+  if (n == InStream::traits::to_int_type(c))
+    return in;
 
+  if (n != InStream::traits::eof())
+    in.unget();
+  in.bad();
   return in;
 }
 
+inline InStream& operator >> (InStream& in, const LiteralWrapper& lit) {
+  return match(in, lit.str, lit.size);
+}
+
 }
 
 template <typename U>
@@ -218,7 +720,7 @@ struct formatter<U, json::InStream> {
     do {
       value_type obj;
       if (format(out, obj))
-        *itr = obj;
+        *itr = std::move(obj);
     }
     while(out.trim(','));
 
@@ -247,7 +749,7 @@ struct formatter<U, json::InStream> {
       if (!out)
         break;
 
-      *itr = value_type(key, value);
+      *itr = value_type(std::move(key), std::move(value));
     }
     while(out.trim(','));
 
@@ -267,7 +769,7 @@ struct formatter<U, json::InStream> {
     do {
       value_type obj;
       if (format(out, obj))
-        *itr = obj;
+        *itr = std::move(obj);
     }
     while(out.trim(','));
 
@@ -299,11 +801,14 @@ template <>
 struct format_override<double, json::OutStream> {
   template <typename Stream>
   static void format(Stream& out, double val) {
-    // format as an integer if there is no decimal part
-    if (val == (int64_t) val)
-      out << std::fixed << (int64_t) val;
-    else
-      out << std::setprecision(std::numeric_limits<double>::digits10) << val;
+    // json has no representation for NaN or the infinities
+    if (!std::isfinite(val)) {
+      out.write("null", 4);
+      return;
+    }
+
+    auto pos = out.reserve(32);
+    out.commit(pos + json::write_number(val, pos));
   }
 };
 
@@ -311,7 +816,9 @@ template <>
 struct format_override<std::string, json::OutStream> {
   template <typename Stream>
   static void format(Stream& out, const std::string& obj) {
-    out << "\"" << obj << "\"";
+    out.write("\"", 1);
+    escaper::escape([&](const char* str, std::size_t len) { out.write(str, len); }, obj.data(), obj.size());
+    out.write("\"", 1);
   }
 };
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+
+#include <string>
+
+namespace json {
+
+// Keeps the text of a document and parses it only as far as it is read. Arrays and objects
+// start out as Lazy values that were merely scanned for their closing bracket; the first has(),
+// lookup(), is<>() or as<>() on one of them, e.g. through a QueryResult or SetterResult, parses
+// its direct members and caches them in its node, so unvisited siblings cost a bracket scan and
+// nothing is parsed twice. A syntax error is only noticed once the malformed part is read,
+// which throws ParseException. Like Document, references must not outlive the document. The
+// parsed members are kept in the nodes rather than written over the values, so any number of
+// threads may read a document at once; changing it needs exclusive access, as with any Value.
+struct LazyDocument {
+  LazyDocument() { }
+
+  explicit LazyDocument(std::size_t chunk_size)
+    : arena(chunk_size) { }
+
+  LazyDocument(const LazyDocument&) = delete;
+  LazyDocument& operator = (const LazyDocument&) = delete;
+
+  // the text is kept inside the document
+  bool parse(std::string str) {
+    clear();
+    text = std::move(str);
+    return load(text.data(), text.size());
+  }
+
+  // data must outlive the document
+  bool parse(const char* data, std::size_t size) {
+    clear();
+    return load(data, size);
+  }
+
+  // the mapping is kept until the document is cleared or reparsed
+  bool open(const std::string& path) {
+    clear();
+    return file.open(path) && load(file.data(), file.size());
+  }
+
+  void clear() {
+    value = nullptr;
+    arena.clear();
+    file.close();
+    std::string().swap(text);
+  }
+
+  Value& root() {
+    return value;
+  }
+
+  const Value& root() const {
+    return value;
+  }
+
+  Arena arena;
+
+private:
+  bool load(const char* data, std::size_t size) {
+    InStream in(data, size);
+    in.arena = &arena;
+    if (!detail::lazy_element(in, value)) {
+      value = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  MappedFile file;
+  std::string text;
+  Value value;
+};
+
+}
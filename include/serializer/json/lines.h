@@ -0,0 +1,262 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace json {
+
+// one record of newline delimited json (NDJSON / JSON Lines)
+struct ParsedLine {
+  // 1-based line number within the input
+  std::size_t line = 0;
+  // byte offset of the start of the line within the input
+  std::size_t offset = 0;
+  // false when the line is not exactly one json value; value is null and error says why then
+  bool ok = false;
+  Value value;
+  std::string error;
+};
+
+namespace detail {
+
+struct LineSpan {
+  const char* begin;
+  const char* end;
+  std::size_t line;
+};
+
+// records cannot contain raw newlines, so every '\n' is a record boundary; blank lines are skipped
+inline std::vector<LineSpan> split_lines(const char* data, std::size_t size) {
+  std::vector<LineSpan> spans;
+  auto end = data + size;
+  for (std::size_t line = 1; data != end; ++line) {
+    auto next = static_cast<const char*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+    if (!next)
+      next = end;
+
+    auto first = data;
+    auto last = next;
+    while (first != last && is_space(*first))
+      ++first;
+    while (last != first && is_space(last[-1]))
+      --last;
+    if (first != last)
+      spans.push_back(LineSpan{first, last, line});
+
+    if (next == end)
+      break;
+    data = next + 1;
+  }
+  return spans;
+}
+
+// groups lines into batches of roughly batch_size bytes, returned as boundaries into spans
+inline std::vector<std::size_t> batch_lines(const std::vector<LineSpan>& spans, std::size_t batch_size = 64 * 1024) {
+  std::vector<std::size_t> bounds(1, 0);
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < spans.size(); ++i) {
+    bytes += static_cast<std::size_t>(spans[i].end - spans[i].begin) + 1;
+    if (bytes >= batch_size) {
+      bounds.push_back(i + 1);
+      bytes = 0;
+    }
+  }
+  if (bounds.back() != spans.size())
+    bounds.push_back(spans.size());
+  return bounds;
+}
+
+inline unsigned worker_count(unsigned threads, std::size_t batches) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads > batches)
+    threads = static_cast<unsigned>(batches);
+  return threads ? threads : 1;
+}
+
+// a malformed line is recorded in res; anything else thrown while parsing propagates
+inline void parse_line(const char* data, const LineSpan& span, ParsedLine& res) {
+  res.line = span.line;
+  res.offset = static_cast<std::size_t>(span.begin - data);
+  auto size = static_cast<std::size_t>(span.end - span.begin);
+  InStream in(span.begin, size);
+  try {
+    ::format(in, res.value);
+    res.ok = in && in.peek() == InStream::traits::eof();
+    if (!res.ok) {
+      auto pos = res.offset + static_cast<std::size_t>(in.cur - span.begin);
+      res.error = ParseException("Malformed json on line ", span.line, " near byte ", pos, ": ",
+                                 std::string(span.begin, std::min<std::size_t>(size, 64))).what();
+    }
+  }
+  catch (const ParseException& e) {
+    res.ok = false;
+    res.error = e.what();
+  }
+  if (!res.ok)
+    res.value = nullptr;
+}
+
+}
+
+// Parses every non-blank line of [data, data + size) as one json value, spreading batches of
+// lines over threads workers (0 picks one per core). Results are returned in input order, one
+// per non-blank line, with malformed lines flagged rather than aborting the rest. Any other
+// exception thrown on a worker, e.g. std::bad_alloc, stops the others and is rethrown here.
+inline std::vector<ParsedLine> parse_lines(const char* data, std::size_t size, unsigned threads = 0) {
+  auto spans = detail::split_lines(data, size);
+  auto bounds = detail::batch_lines(spans);
+  auto batches = bounds.size() - 1;
+  std::vector<ParsedLine> results(spans.size());
+
+  std::atomic<std::size_t> next(0);
+  std::mutex mutex;
+  std::exception_ptr failure;
+  auto work = [&] {
+    try {
+      for (auto idx = next++; idx < batches; idx = next++) {
+        for (auto i = bounds[idx]; i < bounds[idx + 1]; ++i)
+          detail::parse_line(data, spans[i], results[i]);
+      }
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!failure)
+        failure = std::current_exception();
+      next = batches;
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < detail::worker_count(threads, batches); ++i)
+    pool.emplace_back(work);
+  work();
+  for (auto& thread : pool)
+    thread.join();
+
+  if (failure)
+    std::rethrow_exception(failure);
+  return results;
+}
+
+inline std::vector<ParsedLine> parse_lines(const std::string& str, unsigned threads = 0) {
+  return parse_lines(str.data(), str.size(), threads);
+}
+
+inline std::vector<ParsedLine> parse_lines(std::istream& in, unsigned threads = 0) {
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  return parse_lines(contents, threads);
+}
+
+// Same as above, but hands each ParsedLine to callback instead of collecting them. callback is
+// invoked on the calling thread in input order, so it needs no locking, while workers parse a
+// bounded number of batches ahead of it. An exception thrown by callback or by a worker stops
+// the workers and is rethrown.
+template <typename Callback>
+auto parse_lines(const char* data, std::size_t size, Callback&& callback, unsigned threads = 0)
+  -> typename std::enable_if<!std::is_arithmetic<typename std::decay<Callback>::type>::value>::type {
+  auto spans = detail::split_lines(data, size);
+  auto bounds = detail::batch_lines(spans);
+  auto batches = bounds.size() - 1;
+  auto workers = detail::worker_count(threads, batches);
+  auto window = 4 * static_cast<std::size_t>(workers);
+
+  std::vector<std::vector<ParsedLine>> results(batches);
+  std::vector<char> ready(batches, 0);
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::size_t next = 0;
+  std::size_t delivered = 0;
+  bool stop = false;
+  std::exception_ptr failure;
+
+  auto work = [&] {
+    while (true) {
+      std::size_t idx;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return stop || next >= batches || next < delivered + window; });
+        if (stop || next >= batches)
+          return;
+        idx = next++;
+      }
+
+      std::vector<ParsedLine> batch(bounds[idx + 1] - bounds[idx]);
+      try {
+        for (std::size_t i = 0; i < batch.size(); ++i)
+          detail::parse_line(data, spans[bounds[idx] + i], batch[i]);
+      }
+      catch (...) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!failure)
+            failure = std::current_exception();
+          stop = true;
+        }
+        cond.notify_all();
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[idx] = std::move(batch);
+        ready[idx] = 1;
+      }
+      cond.notify_all();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < workers; ++i)
+    pool.emplace_back(work);
+
+  try {
+    for (std::size_t idx = 0; idx < batches; ++idx) {
+      std::vector<ParsedLine> batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return ready[idx] != 0 || failure; });
+        if (!ready[idx])
+          std::rethrow_exception(failure);
+        batch = std::move(results[idx]);
+        delivered = idx + 1;
+      }
+      cond.notify_all();
+
+      for (auto& res : batch)
+        callback(res);
+    }
+  }
+  catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cond.notify_all();
+    for (auto& thread : pool)
+      thread.join();
+    throw;
+  }
+
+  for (auto& thread : pool)
+    thread.join();
+}
+
+template <typename Callback>
+auto parse_lines(const std::string& str, Callback&& callback, unsigned threads = 0)
+  -> typename std::enable_if<!std::is_arithmetic<typename std::decay<Callback>::type>::value>::type {
+  parse_lines(str.data(), str.size(), std::forward<Callback>(callback), threads);
+}
+
+}
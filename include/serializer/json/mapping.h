@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace json {
+
+// Read only contents of a whole file. Regular files are memory mapped, so parsing reads
+// straight from the page cache; anything that cannot be mapped (pipes, empty files, platforms
+// without mmap) is read into memory instead.
+struct MappedFile {
+  MappedFile() { }
+
+  explicit MappedFile(const std::string& path) {
+    open(path);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator = (const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  bool open(const std::string& path) {
+    close();
+#if !defined(_WIN32)
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+      auto addr = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        ::close(fd);
+        ptr = static_cast<const char*>(addr);
+        len = static_cast<std::size_t>(info.st_size);
+        mapped = true;
+        return true;
+      }
+    }
+
+    char chunk[64 * 1024];
+    for (ssize_t res; (res = ::read(fd, chunk, sizeof(chunk))) != 0;) {
+      if (res < 0) {
+        if (errno == EINTR)
+          continue;
+        ::close(fd);
+        return false;
+      }
+      buffer.insert(buffer.end(), chunk, chunk + res);
+    }
+    ::close(fd);
+#else
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if (!in)
+      return false;
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+#endif
+    ptr = buffer.data();
+    len = buffer.size();
+    loaded = true;
+    return true;
+  }
+
+  void close() {
+#if !defined(_WIN32)
+    if (mapped)
+      ::munmap(const_cast<char*>(ptr), len);
+#endif
+    std::vector<char>().swap(buffer);
+    ptr = nullptr;
+    len = 0;
+    mapped = loaded = false;
+  }
+
+  bool is_open() const {
+    return mapped || loaded;
+  }
+
+  const char* data() const {
+    return ptr;
+  }
+
+  std::size_t size() const {
+    return len;
+  }
+
+private:
+  const char* ptr = nullptr;
+  std::size_t len = 0;
+  bool mapped = false;
+  bool loaded = false;
+  std::vector<char> buffer;
+};
+
+}
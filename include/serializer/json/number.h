@@ -0,0 +1,605 @@
+#pragma once
+
+#include <serializer/json/number_tables.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace json {
+namespace detail {
+
+// high 64 bits of a * b
+inline std::uint64_t umul128_hi(std::uint64_t a, std::uint64_t b, std::uint64_t& lo) {
+#if defined(__SIZEOF_INT128__)
+  auto res = static_cast<unsigned __int128>(a) * b;
+  lo = static_cast<std::uint64_t>(res);
+  return static_cast<std::uint64_t>(res >> 64);
+#else
+  std::uint64_t a_lo = a & 0xffffffffu, a_hi = a >> 32;
+  std::uint64_t b_lo = b & 0xffffffffu, b_hi = b >> 32;
+  std::uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+  std::uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+  lo = (mid << 32) | (ll & 0xffffffffu);
+  return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+// (m * mul) >> shift for a 128 bit mul and 64 < shift < 128
+inline std::uint64_t mul_shift64(std::uint64_t m, const std::uint64_t* mul, std::int32_t shift) {
+  std::uint64_t lo0, lo1;
+  auto hi0 = umul128_hi(m, mul[0], lo0);
+  auto hi1 = umul128_hi(m, mul[1], lo1);
+  auto sum = lo1 + hi0;
+  hi1 += sum < lo1;
+  shift -= 64;
+  return (sum >> shift) | (hi1 << (64 - shift));
+}
+
+inline std::int32_t pow5_bits(std::int32_t e) {
+  return ((e * 1217359) >> 19) + 1;
+}
+
+inline std::int32_t log10_pow2(std::int32_t e) {
+  return (e * 78913) >> 18;
+}
+
+inline std::int32_t log10_pow5(std::int32_t e) {
+  return (e * 732923) >> 20;
+}
+
+inline bool multiple_of_pow5(std::uint64_t val, std::int32_t p) {
+  std::int32_t count = 0;
+  while (val % 5 == 0) {
+    val /= 5;
+    ++count;
+  }
+  return count >= p;
+}
+
+inline bool multiple_of_pow2(std::uint64_t val, std::int32_t p) {
+  return (val & ((std::uint64_t(1) << p) - 1)) == 0;
+}
+
+struct Decimal {
+  std::uint64_t digits;
+  std::int32_t exponent;
+};
+
+// Shortest decimal digits * 10^exponent that rounds back to the given positive finite double,
+// following Ulf Adams' Ryu algorithm.
+inline Decimal shortest(std::uint64_t ieee_mantissa, std::uint32_t ieee_exponent) {
+  const std::int32_t pow5_bitcount = 125;
+  const std::int32_t pow5_inv_bitcount = 125;
+
+  std::int32_t e2;
+  std::uint64_t m2;
+  if (ieee_exponent == 0) {
+    e2 = 1 - 1023 - 52 - 2;
+    m2 = ieee_mantissa;
+  }
+  else {
+    e2 = static_cast<std::int32_t>(ieee_exponent) - 1023 - 52 - 2;
+    m2 = (std::uint64_t(1) << 52) | ieee_mantissa;
+  }
+
+  const bool accept_bounds = (m2 & 1) == 0;
+  const std::uint64_t mv = 4 * m2;
+  const std::uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+  // the interval of values that round to this double is (vm, vp), vr is the double itself
+  std::uint64_t vr, vp, vm;
+  std::int32_t e10;
+  bool vm_trailing_zeros = false;
+  bool vr_trailing_zeros = false;
+
+  if (e2 >= 0) {
+    const std::int32_t q = log10_pow2(e2) - (e2 > 3);
+    const std::int32_t k = pow5_inv_bitcount + pow5_bits(q) - 1;
+    const std::int32_t i = -e2 + q + k;
+    const auto mul = pow5_tables<>::inverse_split[q];
+    e10 = q;
+    vr = mul_shift64(mv, mul, i);
+    vp = mul_shift64(mv + 2, mul, i);
+    vm = mul_shift64(mv - 1 - mm_shift, mul, i);
+
+    if (q <= 21) {
+      if (mv % 5 == 0)
+        vr_trailing_zeros = multiple_of_pow5(mv, q);
+      else if (accept_bounds)
+        vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+      else
+        vp -= multiple_of_pow5(mv + 2, q);
+    }
+  }
+  else {
+    const std::int32_t q = log10_pow5(-e2) - (-e2 > 1);
+    const std::int32_t i = -e2 - q;
+    const std::int32_t k = pow5_bits(i) - pow5_bitcount;
+    const std::int32_t j = q - k;
+    const auto mul = pow5_tables<>::split[i];
+    e10 = q + e2;
+    vr = mul_shift64(mv, mul, j);
+    vp = mul_shift64(mv + 2, mul, j);
+    vm = mul_shift64(mv - 1 - mm_shift, mul, j);
+
+    if (q <= 1) {
+      vr_trailing_zeros = true;
+      if (accept_bounds)
+        vm_trailing_zeros = mm_shift == 1;
+      else
+        --vp;
+    }
+    else if (q < 63) {
+      vr_trailing_zeros = multiple_of_pow2(mv, q);
+    }
+  }
+
+  // drop digits while the interval still pins down a unique shortest value
+  std::int32_t removed = 0;
+  std::uint64_t output;
+  if (vm_trailing_zeros || vr_trailing_zeros) {
+    std::uint32_t last_removed = 0;
+    while (vp / 10 > vm / 10) {
+      vm_trailing_zeros &= vm % 10 == 0;
+      vr_trailing_zeros &= last_removed == 0;
+      last_removed = static_cast<std::uint32_t>(vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      ++removed;
+    }
+    if (vm_trailing_zeros) {
+      while (vm % 10 == 0) {
+        vr_trailing_zeros &= last_removed == 0;
+        last_removed = static_cast<std::uint32_t>(vr % 10);
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        ++removed;
+      }
+    }
+    // exactly halfway: round to even
+    if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+      last_removed = 4;
+    output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+  }
+  else {
+    bool round_up = false;
+    while (vp / 10 > vm / 10) {
+      round_up = vr % 10 >= 5;
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      ++removed;
+    }
+    output = vr + (vr == vm || round_up);
+  }
+
+  return Decimal{output, e10 + removed};
+}
+
+inline std::size_t write_digits(std::uint64_t val, char* out) {
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+  char buf[20];
+  auto pos = buf + sizeof(buf);
+  while (val >= 100) {
+    auto idx = (val % 100) * 2;
+    val /= 100;
+    *--pos = pairs[idx + 1];
+    *--pos = pairs[idx];
+  }
+  if (val >= 10) {
+    *--pos = pairs[val * 2 + 1];
+    *--pos = pairs[val * 2];
+  }
+  else {
+    *--pos = static_cast<char>('0' + val);
+  }
+
+  auto len = static_cast<std::size_t>(buf + sizeof(buf) - pos);
+  std::memcpy(out, pos, len);
+  return len;
+}
+
+inline std::size_t write_integer(std::int64_t val, char* out) {
+  if (val < 0) {
+    *out = '-';
+    return 1 + write_digits(std::uint64_t(0) - static_cast<std::uint64_t>(val), out + 1);
+  }
+  return write_digits(static_cast<std::uint64_t>(val), out);
+}
+
+}
+
+// Writes the shortest text that parses back to val into out, which must hold at least 32
+// characters, and returns its length. Integral values up to 2^53 are written without a fraction
+// or exponent; otherwise the notation follows ECMAScript's Number.prototype.toString, which keeps
+// plain decimals for magnitudes in [1e-6, 1e21). val must be finite.
+inline std::size_t write_number(double val, char* out) {
+  const double max_exact = 9007199254740992.0;
+  if (val >= -max_exact && val <= max_exact) {
+    auto integral = static_cast<std::int64_t>(val);
+    if (static_cast<double>(integral) == val)
+      return detail::write_integer(integral, out);
+  }
+
+  std::uint64_t bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+
+  auto start = out;
+  if (bits >> 63)
+    *out++ = '-';
+
+  auto dec = detail::shortest(bits & ((std::uint64_t(1) << 52) - 1), static_cast<std::uint32_t>((bits >> 52) & 0x7ff));
+
+  char digits[20];
+  auto count = static_cast<std::int32_t>(detail::write_digits(dec.digits, digits));
+  // position of the decimal point relative to the first digit
+  auto point = dec.exponent + count;
+
+  if (count <= point && point <= 21) {
+    std::memcpy(out, digits, count);
+    std::memset(out + count, '0', point - count);
+    out += point;
+  }
+  else if (0 < point && point <= 21) {
+    std::memcpy(out, digits, point);
+    out[point] = '.';
+    std::memcpy(out + point + 1, digits + point, count - point);
+    out += count + 1;
+  }
+  else if (-6 < point && point <= 0) {
+    out[0] = '0';
+    out[1] = '.';
+    std::memset(out + 2, '0', -point);
+    std::memcpy(out + 2 - point, digits, count);
+    out += 2 - point + count;
+  }
+  else {
+    *out++ = digits[0];
+    if (count > 1) {
+      *out++ = '.';
+      std::memcpy(out, digits + 1, count - 1);
+      out += count - 1;
+    }
+    *out++ = 'e';
+    auto exp = point - 1;
+    if (exp < 0) {
+      *out++ = '-';
+      exp = -exp;
+    }
+    else {
+      *out++ = '+';
+    }
+    out += detail::write_digits(static_cast<std::uint64_t>(exp), out);
+  }
+
+  return static_cast<std::size_t>(out - start);
+}
+
+namespace detail {
+
+template <typename T>
+struct binary_format;
+
+template <>
+struct binary_format<double> {
+  typedef std::uint64_t bits_type;
+  static const int mantissa_bits = 52;
+  static const int minimum_exponent = -1023;
+  static const int infinite_power = 0x7ff;
+  static const int smallest_power_of_ten = -342;
+  static const int largest_power_of_ten = 308;
+  static const int min_round_to_even = -4;
+  static const int max_round_to_even = 23;
+  static const int max_exact_power = 22;
+
+  static double exact_power(int q) {
+    static const double powers[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    return powers[q];
+  }
+};
+
+template <>
+struct binary_format<float> {
+  typedef std::uint32_t bits_type;
+  static const int mantissa_bits = 23;
+  static const int minimum_exponent = -127;
+  static const int infinite_power = 0xff;
+  static const int smallest_power_of_ten = -65;
+  static const int largest_power_of_ten = 38;
+  static const int min_round_to_even = -17;
+  static const int max_round_to_even = 10;
+  static const int max_exact_power = 10;
+
+  static float exact_power(int q) {
+    static const float powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    return powers[q];
+  }
+};
+
+// Eisel-Lemire: rounds w * 10^q to the nearest T using a 128 bit approximation of 5^q.
+// Returns false in the rare cases where the approximation cannot decide the rounding.
+template <typename T>
+bool eisel_lemire(std::uint64_t w, std::int64_t q, bool negative, T& val) {
+  typedef binary_format<T> format;
+  typedef typename format::bits_type bits_type;
+
+  std::uint64_t mantissa = 0;
+  std::int64_t power2 = 0;
+
+  if (w == 0 || q < format::smallest_power_of_ten) {
+    power2 = 0;
+  }
+  else if (q > format::largest_power_of_ten) {
+    power2 = format::infinite_power;
+  }
+  else {
+    int lz = 0;
+    while (!(w & (std::uint64_t(1) << 63))) {
+      w <<= 1;
+      ++lz;
+    }
+
+    const auto pow5 = pow5_tables<>::truncated[q + 342];
+    std::uint64_t low;
+    auto high = umul128_hi(w, pow5[0], low);
+    const std::uint64_t precision_mask = ~std::uint64_t(0) >> (format::mantissa_bits + 3);
+    if ((high & precision_mask) == precision_mask) {
+      std::uint64_t low2;
+      auto high2 = umul128_hi(w, pow5[1], low2);
+      low += high2;
+      if (high2 > low)
+        ++high;
+      if (low == ~std::uint64_t(0) && (q < -27 || q > 55))
+        return false;
+    }
+
+    const int upper = static_cast<int>(high >> 63);
+    const int shift = upper + 64 - format::mantissa_bits - 3;
+    mantissa = high >> shift;
+    power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz - format::minimum_exponent;
+
+    if (power2 <= 0) {
+      // subnormal
+      if (-power2 + 1 >= 64) {
+        mantissa = 0;
+        power2 = 0;
+      }
+      else {
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < (std::uint64_t(1) << format::mantissa_bits) ? 0 : 1;
+      }
+    }
+    else {
+      // exactly halfway between two floats: round to even
+      if (low <= 1 && q >= format::min_round_to_even && q <= format::max_round_to_even &&
+          (mantissa & 3) == 1 && (mantissa << shift) == high)
+        mantissa &= ~std::uint64_t(1);
+
+      mantissa += mantissa & 1;
+      mantissa >>= 1;
+      if (mantissa >= (std::uint64_t(2) << format::mantissa_bits)) {
+        mantissa = std::uint64_t(1) << format::mantissa_bits;
+        ++power2;
+      }
+      mantissa &= ~(std::uint64_t(1) << format::mantissa_bits);
+      if (power2 >= format::infinite_power) {
+        power2 = format::infinite_power;
+        mantissa = 0;
+      }
+    }
+  }
+
+  auto bits = static_cast<bits_type>(mantissa | (static_cast<std::uint64_t>(power2) << format::mantissa_bits));
+  if (negative)
+    bits |= bits_type(1) << (sizeof(bits_type) * 8 - 1);
+  std::memcpy(&val, &bits, sizeof(val));
+  return true;
+}
+
+// the digits of a json number, split up as described by its grammar
+struct NumberText {
+  const char* int_begin;
+  const char* int_end;
+  const char* frac_begin;
+  const char* frac_end;
+  std::int64_t exponent;
+  bool negative;
+};
+
+inline bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// matches -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and returns the end of the match
+inline const char* scan_number(const char* itr, const char* end, NumberText& num) {
+  num.negative = itr != end && *itr == '-';
+  if (num.negative)
+    ++itr;
+
+  num.int_begin = itr;
+  if (itr == end || !is_digit(*itr))
+    return nullptr;
+  if (*itr++ != '0') {
+    while (itr != end && is_digit(*itr))
+      ++itr;
+  }
+  num.int_end = itr;
+
+  num.frac_begin = num.frac_end = itr;
+  if (itr != end && *itr == '.') {
+    num.frac_begin = ++itr;
+    while (itr != end && is_digit(*itr))
+      ++itr;
+    if (itr == num.frac_begin)
+      return nullptr;
+    num.frac_end = itr;
+  }
+
+  num.exponent = 0;
+  if (itr != end && (*itr == 'e' || *itr == 'E')) {
+    ++itr;
+    bool negative = itr != end && *itr == '-';
+    if (itr != end && (*itr == '-' || *itr == '+'))
+      ++itr;
+    if (itr == end || !is_digit(*itr))
+      return nullptr;
+    for (; itr != end && is_digit(*itr); ++itr) {
+      // anything this large is already zero or infinite
+      if (num.exponent < 100000)
+        num.exponent = num.exponent * 10 + (*itr - '0');
+    }
+    if (negative)
+      num.exponent = -num.exponent;
+  }
+
+  return itr;
+}
+
+// reassembles the matched text and converts it with the classic locale; only used for the
+// inputs Eisel-Lemire cannot round on its own
+template <typename T>
+bool convert_slow(const NumberText& num, T& val) {
+  std::string text(num.negative ? "-" : "");
+  text.append(num.int_begin, num.int_end);
+  if (num.frac_begin != num.frac_end)
+    text.append(".").append(num.frac_begin, num.frac_end);
+  text.append("e").append(std::to_string(num.exponent));
+
+  std::istringstream str(text);
+  str.imbue(std::locale::classic());
+  str >> val;
+  return !str.fail();
+}
+
+template <typename T>
+auto convert(const NumberText& num, T& val) -> typename std::enable_if<std::is_floating_point<T>::value, bool>::type {
+  // collect up to 19 significant digits, which always fit into 64 bits
+  std::uint64_t w = 0;
+  int digits = 0;
+  std::int64_t dropped = 0;
+  bool truncated = false;
+  std::int64_t q = num.exponent - (num.frac_end - num.frac_begin);
+
+  auto take = [&](const char* itr, const char* end) {
+    for (; itr != end; ++itr) {
+      if (digits == 19) {
+        truncated |= *itr != '0';
+        ++dropped;
+      }
+      else if (digits || *itr != '0') {
+        w = w * 10 + (*itr - '0');
+        ++digits;
+      }
+    }
+  };
+  take(num.int_begin, num.int_end);
+  take(num.frac_begin, num.frac_end);
+  q += dropped;
+
+  if (std::is_same<T, long double>::value)
+    return convert_slow(num, val);
+
+  typedef typename std::conditional<std::is_same<T, float>::value, float, double>::type binary;
+  typedef binary_format<binary> format;
+  binary res;
+
+  // Clinger's fast path: both operands are exact, so a single rounding gives the right answer
+  if (!truncated && w <= (std::uint64_t(2) << format::mantissa_bits) &&
+      q >= -format::max_exact_power && q <= format::max_exact_power) {
+    res = static_cast<binary>(w);
+    if (q < 0)
+      res /= format::exact_power(static_cast<int>(-q));
+    else
+      res *= format::exact_power(static_cast<int>(q));
+    val = num.negative ? -res : res;
+    return true;
+  }
+
+  if (!eisel_lemire(w, q, num.negative, res))
+    return convert_slow(num, val);
+
+  if (truncated) {
+    // the dropped digits only matter if they could push the result to the next float
+    binary up;
+    if (!eisel_lemire(w + 1, q, num.negative, up) || up != res)
+      return convert_slow(num, val);
+  }
+
+  // like the istream conversions, out of range values are an error rather than infinity
+  if (std::isinf(res))
+    return false;
+
+  val = res;
+  return true;
+}
+
+template <typename T>
+auto convert(const NumberText& num, T& val) -> typename std::enable_if<std::is_integral<T>::value, bool>::type {
+  if (num.frac_begin != num.frac_end || num.exponent != 0) {
+    // only accept exponent or fraction notation if it denotes an integer that fits
+    double res;
+    if (!convert(num, res) || res != std::floor(res) ||
+        res < static_cast<double>(std::numeric_limits<T>::min()) ||
+        res >= std::ldexp(1.0, std::numeric_limits<T>::digits))
+      return false;
+    val = static_cast<T>(res);
+    return true;
+  }
+
+  std::uint64_t magnitude = 0;
+  for (auto itr = num.int_begin; itr != num.int_end; ++itr) {
+    const std::uint64_t digit = *itr - '0';
+    if (magnitude > (~std::uint64_t(0) - digit) / 10)
+      return false;
+    magnitude = magnitude * 10 + digit;
+  }
+
+  typedef typename std::make_unsigned<T>::type unsigned_type;
+  const std::uint64_t max = static_cast<unsigned_type>(std::numeric_limits<T>::max());
+  if (num.negative) {
+    // the magnitude of min() is max() + 1 for signed types and 0 for unsigned ones
+    const std::uint64_t limit = std::is_signed<T>::value ? max + 1 : 0;
+    if (magnitude > limit)
+      return false;
+    val = static_cast<T>(std::uint64_t(0) - magnitude);
+  }
+  else {
+    if (magnitude > max)
+      return false;
+    val = static_cast<T>(magnitude);
+  }
+  return true;
+}
+
+}
+
+// Parses a json number at the start of [begin, end) into val, independent of the global locale.
+// Returns the end of the number, or nullptr if there is no valid number or it does not fit T.
+template <typename T>
+const char* read_number(const char* begin, const char* end, T& val) {
+  detail::NumberText num;
+  auto last = detail::scan_number(begin, end, num);
+  if (!last || !detail::convert(num, val))
+    return nullptr;
+  return last;
+}
+
+}
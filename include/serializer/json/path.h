@@ -0,0 +1,218 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace json {
+
+namespace detail {
+
+// splits a json pointer ("/features/0/name") into its unescaped reference tokens
+inline std::vector<std::string> pointer_tokens(const std::string& path) {
+  std::vector<std::string> tokens;
+  for (std::size_t pos = 0; pos < path.size();) {
+    if (path[pos] != '/')
+      break;
+    std::string token;
+    for (++pos; pos < path.size() && path[pos] != '/'; ++pos) {
+      if (path[pos] == '~' && pos + 1 < path.size() && (path[pos + 1] == '0' || path[pos + 1] == '1'))
+        token += path[++pos] == '0' ? '~' : '/';
+      else
+        token += path[pos];
+    }
+    tokens.push_back(std::move(token));
+  }
+  return tokens;
+}
+
+// the array index a reference token names, or the largest std::size_t if it names none; tokens
+// of more than 18 digits are not taken as indices, so reading one cannot overflow
+inline std::size_t pointer_index(const std::string& token) {
+  const auto none = std::numeric_limits<std::size_t>::max();
+  if (token.empty() || token.size() > 18 || (token[0] == '0' && token.size() > 1))
+    return none;
+
+  std::size_t idx = 0;
+  for (auto c : token) {
+    if (c < '0' || c > '9')
+      return none;
+    idx = idx * 10 + static_cast<std::size_t>(c - '0');
+  }
+  return idx;
+}
+
+}
+
+// A query path that is resolved once and then evaluated any number of times. Unlike chained
+// QueryResult lookups, evaluation builds no key list and no temporary strings, so it does not
+// allocate. Each step names an object member; steps that are array indices (no leading zeros)
+// also address array elements, as in a json pointer.
+//
+//   static const Path name("/features/0/properties/name");
+//   const String& str = name.get<String>(value);
+struct Path {
+  static const std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  struct Step {
+    Step(const char* key_) : Step(std::string(key_)) { }
+
+    Step(std::string key_)
+      : key(std::move(key_)), atom(key), index(detail::pointer_index(key)) { }
+
+    Step(std::size_t index_)
+      : key(std::to_string(index_)), atom(key), index(index_) { }
+
+    Step(int index_)
+      : Step(static_cast<std::size_t>(index_)) { }
+
+    std::string key;
+    // interned once, so evaluation hashes and compares keys by pointer
+    Atom atom;
+    std::size_t index;
+  };
+
+  Path() { }
+
+  // from a json pointer such as "/a/0/b"; "" is the root itself
+  explicit Path(const std::string& pointer) {
+    for (auto& token : detail::pointer_tokens(pointer))
+      steps.emplace_back(std::move(token));
+  }
+
+  explicit Path(const char* pointer)
+    : Path(std::string(pointer)) { }
+
+  // from keys and indices, e.g. Path{"features", 0, "properties"}
+  Path(std::initializer_list<Step> steps_)
+    : steps(steps_) { }
+
+  // the addressed value, or nullptr if it does not exist
+  const Value* find(const Value& root) const {
+    return resolve(root);
+  }
+
+  // same, but as the result may be changed, shared nodes along the path are copied first
+  Value* find(Value& root) const {
+    return resolve(root);
+  }
+
+  bool exists(const Value& root) const {
+    return find(root) != nullptr;
+  }
+
+  template <typename Type>
+  const Type& get(const Value& root) const {
+    auto val = find(root);
+    if (!val)
+      throw AccessException("Invalid Path: ", str());
+    return val->as<Type>();
+  }
+
+  template <typename Type>
+  Type& get(Value& root) const {
+    auto val = find(root);
+    if (!val)
+      throw AccessException("Invalid Path: ", str());
+    return val->as<Type>();
+  }
+
+  // the addressed value if it exists and has the requested type, otherwise def
+  template <typename Type>
+  Type get_or(const Value& root, const Type& def) const {
+    auto val = find(root);
+    return val && val->is<Type>() ? val->as<Type>() : def;
+  }
+
+  // Assigns to the addressed value, creating what is missing along the way. Index steps extend
+  // arrays and turn null into an array; other steps turn null into an object. Values that are
+  // in the way are never replaced: a step into anything else throws TypeException, before
+  // anything was created. Like Value::set, copies val first, as it may live inside the path.
+  Value& set(Value& root, const Value& val) const {
+    Value copy(val);
+    auto cur = &root;
+    for (const auto& step : steps) {
+      cur = touch(cur);
+      if (cur->is<Object>()) {
+        cur = &cur->data.object->value[step.atom];
+      }
+      else if (step.index != npos && cur->is<Array>()) {
+        auto& arr = cur->data.array->value;
+        if (step.index >= arr.size())
+          arr.resize(step.index + 1);
+        cur = &arr[step.index];
+      }
+      else if (!cur->is<Null>()) {
+        throw TypeException("Invalid Path: ", str(), " steps into a value that is not a container for '", step.key, "'");
+      }
+      else if (step.index != npos) {
+        *cur = Array();
+        cur->data.array->value.resize(step.index + 1);
+        cur = &cur->data.array->value[step.index];
+      }
+      else {
+        *cur = Object();
+        cur = &cur->data.object->value[step.atom];
+      }
+    }
+    *cur = std::move(copy);
+    return *cur;
+  }
+
+  // the path as a json pointer
+  std::string str() const {
+    std::string res;
+    for (const auto& step : steps) {
+      res += '/';
+      for (auto c : step.key) {
+        if (c == '~')
+          res += "~0";
+        else if (c == '/')
+          res += "~1";
+        else
+          res += c;
+      }
+    }
+    return res;
+  }
+
+  std::vector<Step> steps;
+
+private:
+  template <typename V>
+  V* resolve(V& root) const {
+    auto cur = &root;
+    for (const auto& step : steps) {
+      cur = touch(cur);
+      if (cur->type == Value::Type::Object) {
+        auto& obj = cur->data.object->value;
+        auto itr = obj.find(step.atom);
+        if (itr == obj.end())
+          return nullptr;
+        cur = &itr->second;
+      }
+      else if (cur->type == Value::Type::Array && step.index < cur->data.array->value.size()) {
+        cur = &cur->data.array->value[step.index];
+      }
+      else {
+        return nullptr;
+      }
+    }
+    return cur;
+  }
+
+  // reading goes through the parsed value of a Lazy one, changing expands it in place
+  static const Value* touch(const Value* val) {
+    return &val->expanded();
+  }
+
+  static Value* touch(Value* val) {
+    val->detach();
+    return val;
+  }
+};
+
+}
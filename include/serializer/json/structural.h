@@ -0,0 +1,317 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+#include <serializer/json/blocks.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace json {
+
+namespace detail {
+
+// Stage 1: records the offset of every structural character ({ } [ ] : ,), every opening quote
+// and the first character of every other scalar that lies outside of a string. Returns false
+// when the input ends inside a string.
+inline bool structural_index(const char* data, std::size_t size, std::vector<std::uint32_t>& index) {
+  index.clear();
+  index.reserve(size / 8);
+
+  std::uint64_t escape_carry = 0;
+  std::uint64_t string_carry = 0;
+  std::uint64_t scalar_carry = 0;
+  char tail[64];
+
+  for (std::size_t base = 0; base < size; base += 64) {
+    auto block = data + base;
+    if (size - base < 64) {
+      std::memset(tail, ' ', sizeof(tail));
+      std::memcpy(tail, block, size - base);
+      block = tail;
+    }
+
+    BlockMasks masks;
+    classify(block, masks);
+
+    auto quotes = masks.quote & ~escaped_mask(masks.backslash, escape_carry);
+    // set from an opening quote up to, but excluding, its closing quote
+    auto in_string = prefix_xor(quotes) ^ string_carry;
+    string_carry = std::uint64_t(0) - (in_string >> 63);
+
+    auto scalar = ~(masks.op | masks.space | quotes);
+    auto scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+    scalar_carry = scalar >> 63;
+
+    auto structurals = (masks.op | quotes | scalar_start) & ~(in_string ^ quotes);
+    while (structurals) {
+      index.push_back(static_cast<std::uint32_t>(base + first_bit64(structurals)));
+      structurals &= structurals - 1;
+    }
+  }
+  return string_carry == 0;
+}
+
+// pairs every opening bracket in the index with its closing one
+inline bool match_brackets(const char* data, const std::vector<std::uint32_t>& index, std::vector<std::uint32_t>& match) {
+  match.assign(index.size(), 0);
+  std::vector<std::uint32_t> open;
+  for (std::size_t i = 0; i < index.size(); ++i) {
+    auto c = data[index[i]];
+    if (c == '{' || c == '[') {
+      open.push_back(static_cast<std::uint32_t>(i));
+    }
+    else if (c == '}' || c == ']') {
+      if (open.empty() || data[index[open.back()]] != (c == '}' ? '{' : '['))
+        return false;
+      match[open.back()] = static_cast<std::uint32_t>(i);
+      open.pop_back();
+    }
+  }
+  return open.empty();
+}
+
+// Stage 2: builds the Value tree from the structural index. Since every bracket knows its
+// partner, the elements of a large container can be located without parsing them and are
+// handed out to worker threads in slices.
+struct TreeBuilder {
+  const char* data;
+  std::size_t size;
+  const std::vector<std::uint32_t>& index;
+  const std::vector<std::uint32_t>& match;
+  unsigned threads;
+
+  // containers spanning fewer index entries are not worth splitting
+  static const std::size_t split_span = 16 * 1024;
+
+  // only whitespace may sit between the end of a scalar and the next index entry
+  bool ends_at(const char* itr, std::size_t i) const {
+    auto stop = i + 1 < index.size() ? data + index[i + 1] : data + size;
+    while (itr < stop && is_space(*itr))
+      ++itr;
+    return itr == stop;
+  }
+
+  bool string(std::size_t i, String& str) const {
+    auto pos = data + index[i] + 1;
+    InStream in(pos, static_cast<std::size_t>(data + size - pos));
+    in >> str >> '"';
+    return in && ends_at(in.cur, i);
+  }
+
+  bool key(std::size_t i, Atom& atom) const {
+    auto pos = data + index[i] + 1;
+    InStream in(pos, static_cast<std::size_t>(data + size - pos));
+    detail::read_atom(in, atom);
+    return in && ends_at(in.cur, i);
+  }
+
+  bool literal(std::size_t i, const char* str, std::size_t len) const {
+    auto pos = data + index[i];
+    return static_cast<std::size_t>(data + size - pos) >= len && std::memcmp(pos, str, len) == 0 && ends_at(pos + len, i);
+  }
+
+  // parses the value at index entry i and moves i past it
+  bool value(std::size_t& i, Value& out, bool parallel) const {
+    switch (data[index[i]]) {
+      case '{':
+        return object(i, out, parallel);
+      case '[':
+        return array(i, out, parallel);
+      case '"': {
+        String str;
+        if (!string(i, str))
+          return false;
+        out = std::move(str);
+        break;
+      }
+      case 't':
+        if (!literal(i, "true", 4))
+          return false;
+        out = true;
+        break;
+      case 'f':
+        if (!literal(i, "false", 5))
+          return false;
+        out = false;
+        break;
+      case 'n':
+        if (!literal(i, "null", 4))
+          return false;
+        out = nullptr;
+        break;
+      default: {
+        Number num;
+        auto end = read_number(data + index[i], data + size, num);
+        if (!end || !ends_at(end, i))
+          return false;
+        out = num;
+      }
+    }
+    ++i;
+    return true;
+  }
+
+  // index entries of each element of the container opening at open, or of each key for objects
+  bool elements(std::size_t open, bool keys, std::vector<std::size_t>& starts) const {
+    auto close = match[open];
+    auto i = open + 1;
+    if (i == close)
+      return true;
+
+    while (true) {
+      starts.push_back(i);
+      if (keys) {
+        if (i + 2 >= close || data[index[i]] != '"' || data[index[i + 1]] != ':')
+          return false;
+        i += 2;
+      }
+
+      auto c = data[index[i]];
+      i = c == '{' || c == '[' ? match[i] + 1 : i + 1;
+      if (i == close)
+        return true;
+      if (data[index[i]] != ',' || ++i == close)
+        return false;
+    }
+  }
+
+  template <typename Work>
+  bool split(std::size_t count, Work work) const {
+    return parallel_for(count, threads, work);
+  }
+
+  bool splittable(std::size_t open, bool parallel) const {
+    return parallel && threads > 1 && match[open] - open >= split_span;
+  }
+
+  bool array(std::size_t& i, Value& out, bool parallel) const {
+    auto close = match[i];
+    Array arr;
+
+    std::vector<std::size_t> starts;
+    if (splittable(i, parallel)) {
+      if (!elements(i, false, starts))
+        return false;
+    }
+
+    if (starts.size() >= threads * 4) {
+      arr.resize(starts.size());
+      auto ok = split(starts.size(), [&](std::size_t begin, std::size_t end) -> bool {
+        for (auto j = begin; j < end; ++j) {
+          auto pos = starts[j];
+          if (!value(pos, arr[j], false) || pos != (j + 1 < starts.size() ? starts[j + 1] - 1 : close))
+            return false;
+        }
+        return true;
+      });
+      if (!ok)
+        return false;
+    }
+    else if (++i != close) {
+      while (true) {
+        Value val;
+        if (!value(i, val, parallel))
+          return false;
+        arr.push_back(std::move(val));
+        if (i == close)
+          break;
+        if (data[index[i]] != ',' || ++i == close)
+          return false;
+      }
+    }
+
+    out = std::move(arr);
+    i = close + 1;
+    return true;
+  }
+
+  bool object(std::size_t& i, Value& out, bool parallel) const {
+    auto close = match[i];
+    Object obj;
+
+    std::vector<std::size_t> starts;
+    if (splittable(i, parallel)) {
+      if (!elements(i, true, starts))
+        return false;
+    }
+
+    if (starts.size() >= threads * 4) {
+      std::vector<Atom> keys(starts.size());
+      std::vector<Value> vals(starts.size());
+      auto ok = split(starts.size(), [&](std::size_t begin, std::size_t end) -> bool {
+        for (auto j = begin; j < end; ++j) {
+          auto pos = starts[j] + 2;
+          if (!key(starts[j], keys[j]) || !value(pos, vals[j], false) || pos != (j + 1 < starts.size() ? starts[j + 1] - 1 : close))
+            return false;
+        }
+        return true;
+      });
+      if (!ok)
+        return false;
+
+      obj.reserve(keys.size());
+      for (std::size_t j = 0; j < keys.size(); ++j)
+        obj.emplace(keys[j], std::move(vals[j]));
+    }
+    else if (++i != close) {
+      while (true) {
+        Atom name;
+        Value val;
+        if (data[index[i]] != '"' || !key(i, name) || data[index[i + 1]] != ':')
+          return false;
+        i += 2;
+        if (i == close || !value(i, val, parallel))
+          return false;
+        obj.emplace(name, std::move(val));
+        if (i == close)
+          break;
+        if (data[index[i]] != ',' || ++i == close)
+          return false;
+      }
+    }
+
+    out = std::move(obj);
+    i = close + 1;
+    return true;
+  }
+};
+
+}
+
+// Parses one complete document in two passes: a SIMD scan that indexes every structural
+// character, followed by building the tree from that index, with the elements of large arrays
+// and objects spread over threads workers (0 picks one per core). Unlike Value::parse, nothing
+// but whitespace may follow the document. Inputs of 4GB and more exceed the 32 bit index and
+// are parsed serially.
+inline bool parse_parallel(const char* data, std::size_t size, Value& value, unsigned threads = 0) {
+  if (size >= std::numeric_limits<std::uint32_t>::max())
+    return value.parse(data, size);
+
+  std::vector<std::uint32_t> index;
+  std::vector<std::uint32_t> match;
+  if (!detail::structural_index(data, size, index) || index.empty() || !detail::match_brackets(data, index, match))
+    return false;
+
+  if (threads == 0)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  detail::TreeBuilder builder{data, size, index, match, threads};
+  std::size_t i = 0;
+  Value res;
+  if (!builder.value(i, res, true) || i != index.size())
+    return false;
+
+  value = std::move(res);
+  return true;
+}
+
+inline bool parse_parallel(const std::string& str, Value& value, unsigned threads = 0) {
+  return parse_parallel(str.data(), str.size(), value, threads);
+}
+
+}
@@ -0,0 +1,746 @@
+#pragma once
+
+#include <serializer/core.h>
+#include <serializer/json/json.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace msgpack {
+
+// the kinds of value a MessagePack type byte announces
+enum class Type {
+  Nil,
+  Boolean,
+  Integer,
+  Float,
+  String,
+  Binary,
+  Array,
+  Map,
+  Extension,
+  Invalid,
+  End
+};
+
+inline Type type_of(int tag) {
+  if (tag < 0)
+    return Type::End;
+  if (tag <= 0x7f || tag >= 0xe0)
+    return Type::Integer;
+  if (tag <= 0x8f)
+    return Type::Map;
+  if (tag <= 0x9f)
+    return Type::Array;
+  if (tag <= 0xbf)
+    return Type::String;
+
+  switch (tag) {
+    case 0xc0: return Type::Nil;
+    case 0xc2:
+    case 0xc3: return Type::Boolean;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6: return Type::Binary;
+    case 0xc7:
+    case 0xc8:
+    case 0xc9: return Type::Extension;
+    case 0xca:
+    case 0xcb: return Type::Float;
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: return Type::Integer;
+    case 0xd4:
+    case 0xd5:
+    case 0xd6:
+    case 0xd7:
+    case 0xd8: return Type::Extension;
+    case 0xd9:
+    case 0xda:
+    case 0xdb: return Type::String;
+    case 0xdc:
+    case 0xdd: return Type::Array;
+    case 0xde:
+    case 0xdf: return Type::Map;
+    default: return Type::Invalid;
+  }
+}
+
+// Writes MessagePack through the buffering of json::OutStream, so it can target the same
+// strings, std::ostreams, file descriptors and sinks. Every value takes its shortest encoding.
+struct OutStream {
+  typedef json::OutStream::Sink Sink;
+
+  // unlike json::OutStream, buffers in front of the std::ostream too; the bytes are written on
+  // flush() and on destruction
+  OutStream(std::ostream& out)
+    : buffer(Sink([&out](const char* str, std::size_t len) { out.write(str, static_cast<std::streamsize>(len)); })) { }
+
+  OutStream(std::string& out)
+    : buffer(out) { }
+
+  explicit OutStream(int fd)
+    : buffer(fd) { }
+
+  explicit OutStream(Sink sink)
+    : buffer(std::move(sink)) { }
+
+  OutStream(const OutStream&) = delete;
+  OutStream& operator = (const OutStream&) = delete;
+
+  void flush() {
+    buffer.flush();
+  }
+
+  // raw bytes, e.g. a value that was encoded earlier
+  void write(const char* data, std::size_t len) {
+    buffer.write(data, len);
+  }
+
+  void write_nil() {
+    buffer.put(static_cast<char>(0xc0));
+  }
+
+  void write_bool(bool val) {
+    buffer.put(static_cast<char>(val ? 0xc3 : 0xc2));
+  }
+
+  void write_uint(std::uint64_t val) {
+    if (val <= 0x7f)
+      buffer.put(static_cast<char>(val));
+    else if (val <= 0xff)
+      tagged(0xcc, val, 1);
+    else if (val <= 0xffff)
+      tagged(0xcd, val, 2);
+    else if (val <= 0xffffffff)
+      tagged(0xce, val, 4);
+    else
+      tagged(0xcf, val, 8);
+  }
+
+  void write_int(std::int64_t val) {
+    if (val >= 0)
+      write_uint(static_cast<std::uint64_t>(val));
+    else if (val >= -32)
+      buffer.put(static_cast<char>(val));
+    else if (val >= std::numeric_limits<std::int8_t>::min())
+      tagged(0xd0, static_cast<std::uint64_t>(val), 1);
+    else if (val >= std::numeric_limits<std::int16_t>::min())
+      tagged(0xd1, static_cast<std::uint64_t>(val), 2);
+    else if (val >= std::numeric_limits<std::int32_t>::min())
+      tagged(0xd2, static_cast<std::uint64_t>(val), 4);
+    else
+      tagged(0xd3, static_cast<std::uint64_t>(val), 8);
+  }
+
+  void write_float(float val) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    tagged(0xca, bits, 4);
+  }
+
+  // json numbers are doubles that mostly hold small integers, so integral values take the
+  // integer encoding and others a float32 when that holds them exactly
+  void write_double(double val) {
+    if (val >= -9223372036854775808.0 && val < 9223372036854775808.0 && val == std::trunc(val) &&
+        !(val == 0 && std::signbit(val))) {
+      write_int(static_cast<std::int64_t>(val));
+      return;
+    }
+
+    if (std::fabs(val) <= std::numeric_limits<float>::max() && static_cast<double>(static_cast<float>(val)) == val) {
+      write_float(static_cast<float>(val));
+      return;
+    }
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    tagged(0xcb, bits, 8);
+  }
+
+  void write_string(const char* str, std::size_t len) {
+    if (len <= 31)
+      buffer.put(static_cast<char>(0xa0 | len));
+    else if (len <= 0xff)
+      tagged(0xd9, len, 1);
+    else if (len <= 0xffff)
+      tagged(0xda, len, 2);
+    else
+      tagged(0xdb, checked_size(len), 4);
+    buffer.write(str, len);
+  }
+
+  void write_string(const std::string& str) {
+    write_string(str.data(), str.size());
+  }
+
+  // the header of an array; its size elements follow
+  void write_array_size(std::size_t size) {
+    if (size <= 15)
+      buffer.put(static_cast<char>(0x90 | size));
+    else if (size <= 0xffff)
+      tagged(0xdc, size, 2);
+    else
+      tagged(0xdd, checked_size(size), 4);
+  }
+
+  // the header of a map; its size keys and values follow, alternating
+  void write_map_size(std::size_t size) {
+    if (size <= 15)
+      buffer.put(static_cast<char>(0x80 | size));
+    else if (size <= 0xffff)
+      tagged(0xde, size, 2);
+    else
+      tagged(0xdf, checked_size(size), 4);
+  }
+
+private:
+  void tagged(int tag, std::uint64_t val, std::size_t len) {
+    auto pos = buffer.reserve(9);
+    pos[0] = static_cast<char>(tag);
+    for (std::size_t i = 0; i < len; ++i)
+      pos[1 + i] = static_cast<char>(val >> (8 * (len - 1 - i)));
+    buffer.commit(pos + 1 + len);
+  }
+
+  static std::uint64_t checked_size(std::size_t size) {
+    if (static_cast<std::uint64_t>(size) > 0xffffffff)
+      throw std::length_error("msgpack: more than 2^32 - 1 bytes or elements");
+    return size;
+  }
+
+  json::OutStream buffer;
+};
+
+template <typename T>
+auto operator << (OutStream& out, const T& val) -> typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, OutStream&>::type {
+  out.write_int(val);
+  return out;
+}
+
+template <typename T>
+auto operator << (OutStream& out, const T& val) -> typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, bool>::value, OutStream&>::type {
+  out.write_uint(val);
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, bool val) {
+  out.write_bool(val);
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, float val) {
+  out.write_float(val);
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, double val) {
+  out.write_double(val);
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, const char* str) {
+  out.write_string(str, std::strlen(str));
+  return out;
+}
+
+inline OutStream& operator << (OutStream& out, const std::string& str) {
+  out.write_string(str);
+  return out;
+}
+
+namespace detail {
+
+// a decoded number in the representation it was written in
+struct Number {
+  enum class Kind { Signed, Unsigned, Real };
+
+  Kind kind = Kind::Unsigned;
+  std::int64_t i = 0;
+  std::uint64_t u = 0;
+  double d = 0;
+};
+
+template <typename T>
+auto convert(const Number& num, T& val) -> typename std::enable_if<std::is_integral<T>::value, bool>::type {
+  typedef std::numeric_limits<T> limits;
+  switch (num.kind) {
+    case Number::Kind::Unsigned:
+      if (num.u > static_cast<std::uint64_t>(limits::max()))
+        return false;
+      val = static_cast<T>(num.u);
+      return true;
+    case Number::Kind::Signed:
+      if (num.i >= 0) {
+        if (static_cast<std::uint64_t>(num.i) > static_cast<std::uint64_t>(limits::max()))
+          return false;
+      }
+      else if (!limits::is_signed || num.i < static_cast<std::int64_t>(limits::min())) {
+        return false;
+      }
+      val = static_cast<T>(num.i);
+      return true;
+    default:
+      // only integral values convert, and max() + 1 is a power of two that doubles hold exactly
+      if (num.d != std::trunc(num.d) || num.d < static_cast<double>(limits::min()) ||
+          num.d >= static_cast<double>(limits::max()) + 1.0)
+        return false;
+      val = static_cast<T>(num.d);
+      return true;
+  }
+}
+
+template <typename T>
+auto convert(const Number& num, T& val) -> typename std::enable_if<std::is_floating_point<T>::value, bool>::type {
+  switch (num.kind) {
+    case Number::Kind::Unsigned: val = static_cast<T>(num.u); break;
+    case Number::Kind::Signed: val = static_cast<T>(num.i); break;
+    default: val = static_cast<T>(num.d); break;
+  }
+  return true;
+}
+
+}
+
+// Reads MessagePack from a contiguous buffer, or from a std::istream through its streambuf
+// when stream is set. A read that finds a value of the wrong type consumes nothing, so the
+// caller can check next_type() or try another reading.
+struct InStream {
+  typedef std::char_traits<char> traits;
+
+  std::string storage;
+  std::istream* stream = nullptr;
+  const char* cur = nullptr;
+  const char* end = nullptr;
+  bool state = true;
+
+  operator bool() const { return state; }
+  void good() { state = true; }
+  void bad() { state = false; }
+
+  bool contiguous() const { return stream == nullptr; }
+
+  // the next byte without consuming it
+  int peek() {
+    if (contiguous())
+      return cur != end ? traits::to_int_type(*cur) : traits::eof();
+    return stream->rdbuf()->sgetc();
+  }
+
+  int get() {
+    if (contiguous())
+      return cur != end ? traits::to_int_type(*cur++) : traits::eof();
+    return stream->rdbuf()->sbumpc();
+  }
+
+  Type next_type() {
+    return state ? type_of(peek()) : Type::End;
+  }
+
+  // an upper bound on the number of values left, as each one takes at least a byte
+  std::size_t remaining() const {
+    return contiguous() ? static_cast<std::size_t>(end - cur) : std::numeric_limits<std::size_t>::max();
+  }
+
+  bool read(char* out, std::size_t len) {
+    if (!state)
+      return false;
+
+    if (contiguous()) {
+      if (static_cast<std::size_t>(end - cur) < len)
+        return fail();
+      std::memcpy(out, cur, len);
+      cur += len;
+      return true;
+    }
+
+    if (static_cast<std::size_t>(stream->rdbuf()->sgetn(out, static_cast<std::streamsize>(len))) != len)
+      return fail();
+    return true;
+  }
+
+  // Replaces str with the next len bytes. A stream is read 64KB at a time, so a length header
+  // larger than the input allocates no more than the input holds.
+  bool read(std::string& str, std::size_t len) {
+    if (contiguous()) {
+      if (!state || static_cast<std::size_t>(end - cur) < len)
+        return fail();
+      str.assign(cur, len);
+      cur += len;
+      return true;
+    }
+
+    str.clear();
+    while (str.size() < len) {
+      auto pos = str.size();
+      str.resize(pos + std::min<std::size_t>(len - pos, 64 * 1024));
+      if (!read(&str[pos], str.size() - pos))
+        return false;
+    }
+    return state;
+  }
+
+  bool read_nil() {
+    if (next_type() != Type::Nil)
+      return fail();
+    get();
+    return true;
+  }
+
+  bool read_bool(bool& val) {
+    if (next_type() != Type::Boolean)
+      return fail();
+    val = get() == 0xc3;
+    return true;
+  }
+
+  // the length of a string or binary value, leaving its bytes to be read
+  bool read_string_size(std::uint32_t& size) {
+    auto tag = state ? peek() : traits::eof();
+    if (tag >= 0xa0 && tag <= 0xbf) {
+      get();
+      size = static_cast<std::uint32_t>(tag & 0x1f);
+      return true;
+    }
+
+    switch (tag) {
+      case 0xc4:
+      case 0xd9: get(); return read_size<std::uint8_t>(size);
+      case 0xc5:
+      case 0xda: get(); return read_size<std::uint16_t>(size);
+      case 0xc6:
+      case 0xdb: get(); return read_size<std::uint32_t>(size);
+      default: return fail();
+    }
+  }
+
+  bool read_string(std::string& str) {
+    std::uint32_t size;
+    if (!read_string_size(size))
+      return false;
+    return read(str, size);
+  }
+
+  bool read_array_size(std::uint32_t& size) {
+    auto tag = state ? peek() : traits::eof();
+    if (tag >= 0x90 && tag <= 0x9f) {
+      get();
+      size = static_cast<std::uint32_t>(tag & 0x0f);
+      return true;
+    }
+    if (tag == 0xdc) {
+      get();
+      return read_size<std::uint16_t>(size);
+    }
+    if (tag == 0xdd) {
+      get();
+      return read_size<std::uint32_t>(size);
+    }
+    return fail();
+  }
+
+  bool read_map_size(std::uint32_t& size) {
+    auto tag = state ? peek() : traits::eof();
+    if (tag >= 0x80 && tag <= 0x8f) {
+      get();
+      size = static_cast<std::uint32_t>(tag & 0x0f);
+      return true;
+    }
+    if (tag == 0xde) {
+      get();
+      return read_size<std::uint16_t>(size);
+    }
+    if (tag == 0xdf) {
+      get();
+      return read_size<std::uint32_t>(size);
+    }
+    return fail();
+  }
+
+  // reads any integer or float that fits val; integral types take only integral values
+  template <typename T>
+  bool read_number(T& val) {
+    detail::Number num;
+    if (!read_number(num))
+      return false;
+    if (!detail::convert(num, val))
+      return fail();
+    return true;
+  }
+
+  bool read_number(detail::Number& num) {
+    auto tag = state ? peek() : traits::eof();
+    if (type_of(tag) != Type::Integer && type_of(tag) != Type::Float)
+      return fail();
+
+    get();
+    if (tag <= 0x7f) {
+      num.kind = detail::Number::Kind::Unsigned;
+      num.u = static_cast<std::uint64_t>(tag);
+      return true;
+    }
+    if (tag >= 0xe0) {
+      num.kind = detail::Number::Kind::Signed;
+      num.i = tag - 0x100;
+      return true;
+    }
+
+    switch (tag) {
+      case 0xca: {
+        std::uint32_t bits;
+        float val;
+        if (!read_be(bits))
+          return false;
+        std::memcpy(&val, &bits, sizeof(val));
+        num.kind = detail::Number::Kind::Real;
+        num.d = val;
+        return true;
+      }
+      case 0xcb: {
+        std::uint64_t bits;
+        if (!read_be(bits))
+          return false;
+        std::memcpy(&num.d, &bits, sizeof(num.d));
+        num.kind = detail::Number::Kind::Real;
+        return true;
+      }
+      case 0xcc: return read_unsigned<std::uint8_t>(num);
+      case 0xcd: return read_unsigned<std::uint16_t>(num);
+      case 0xce: return read_unsigned<std::uint32_t>(num);
+      case 0xcf: return read_unsigned<std::uint64_t>(num);
+      case 0xd0: return read_signed<std::uint8_t, std::int8_t>(num);
+      case 0xd1: return read_signed<std::uint16_t, std::int16_t>(num);
+      case 0xd2: return read_signed<std::uint32_t, std::int32_t>(num);
+      default: return read_signed<std::uint64_t, std::int64_t>(num);
+    }
+  }
+
+  InStream(const char* data, std::size_t size) : cur(data), end(data + size) { }
+  InStream(const std::string& contents) : InStream(contents.data(), contents.size()) { }
+  InStream(std::string&& contents) : storage(std::move(contents)), cur(storage.data()), end(cur + storage.size()) { }
+  InStream(std::istream& input) : stream(&input) { }
+
+  InStream(const InStream&) = delete;
+  InStream& operator = (const InStream&) = delete;
+
+private:
+  bool fail() {
+    state = false;
+    return false;
+  }
+
+  template <typename T>
+  bool read_be(T& val) {
+    unsigned char bytes[sizeof(T)];
+    if (!read(reinterpret_cast<char*>(bytes), sizeof(T)))
+      return false;
+    val = 0;
+    for (auto b : bytes)
+      val = static_cast<T>((static_cast<std::uint64_t>(val) << 8) | b);
+    return true;
+  }
+
+  template <typename T>
+  bool read_size(std::uint32_t& size) {
+    T val;
+    if (!read_be(val))
+      return false;
+    size = val;
+    return true;
+  }
+
+  template <typename T>
+  bool read_unsigned(detail::Number& num) {
+    T val;
+    if (!read_be(val))
+      return false;
+    num.kind = detail::Number::Kind::Unsigned;
+    num.u = val;
+    return true;
+  }
+
+  template <typename T, typename Signed>
+  bool read_signed(detail::Number& num) {
+    T val;
+    if (!read_be(val))
+      return false;
+    num.kind = detail::Number::Kind::Signed;
+    num.i = static_cast<Signed>(val);
+    return true;
+  }
+};
+
+template <typename T>
+auto operator >> (InStream& in, T& val) -> typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, InStream&>::type {
+  in.read_number(val);
+  return in;
+}
+
+inline InStream& operator >> (InStream& in, bool& val) {
+  in.read_bool(val);
+  return in;
+}
+
+inline InStream& operator >> (InStream& in, std::string& str) {
+  in.read_string(str);
+  return in;
+}
+
+namespace detail {
+
+template <typename T>
+std::size_t range_size(const T& t) {
+  return static_cast<std::size_t>(std::distance(std::begin(t), std::end(t)));
+}
+
+}
+
+}
+
+template <typename U>
+struct formatter<U, msgpack::OutStream> {
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& out, const T& t) -> typename std::enable_if<has_range<T>::value && not has_key<T>::value>::type {
+    out.write_array_size(msgpack::detail::range_size(t));
+    for (const auto& itr : t)
+      format(out, itr);
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& out, const T& t) -> typename std::enable_if<has_key<T>::value && !has_format_override<typename has_key<T>::value_type, Stream>::value>::type {
+    out.write_map_size(msgpack::detail::range_size(t));
+    for (const auto& itr : t) {
+      format(out, getKey(itr));
+      format(out, getValue(itr));
+    }
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& out, const T& t) -> typename std::enable_if<has_key<T>::value && has_format_override<typename has_key<T>::value_type, Stream>::value>::type {
+    out.write_map_size(msgpack::detail::range_size(t));
+    for (const auto& itr : t)
+      format(out, itr);
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& out, const T& t) -> typename std::enable_if<!(has_range<T>::value || has_key<T>::value)>::type {
+    out << t;
+  }
+
+  template <typename T, typename Stream>
+  static auto format(Stream& out, const T& t) -> typename std::enable_if<has_format_override<T, Stream>::value>::type {
+    format_override<T, Stream>::format(out, t);
+  }
+
+  template <typename T, typename Stream>
+  static auto format(Stream& out, const T& t) -> typename std::enable_if<!has_format_override<T, Stream>::value>::type {
+    format_impl(out, t);
+  }
+};
+
+template <typename U>
+struct formatter<U, msgpack::InStream> {
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& in, T& t) -> typename std::enable_if<has_range<T>::value && not has_key<T>::value, bool>::type {
+    typedef typename has_range<T>::value_type value_type;
+    auto itr = std::inserter(t, t.begin());
+
+    std::uint32_t size;
+    if (!in.read_array_size(size))
+      return false;
+
+    for (; size > 0; --size) {
+      value_type obj{};
+      if (!format(in, obj))
+        return false;
+      *itr = std::move(obj);
+    }
+    return in;
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& in, T& t) -> typename std::enable_if<has_key<T>::value && !has_format_override<typename has_key<T>::value_type, Stream>::value, bool>::type {
+    typedef typename has_key<T>::key_type key_type;
+    typedef typename has_key<T>::mapped_type mapped_type;
+    typedef typename has_key<T>::value_type value_type;
+    auto itr = std::inserter(t, t.begin());
+
+    std::uint32_t size;
+    if (!in.read_map_size(size))
+      return false;
+
+    for (; size > 0; --size) {
+      key_type key;
+      mapped_type value;
+      if (!format(in, key) || !format(in, value))
+        return false;
+      *itr = value_type(std::move(key), std::move(value));
+    }
+    return in;
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& in, T& t) -> typename std::enable_if<has_key<T>::value && has_format_override<typename has_key<T>::value_type, Stream>::value, bool>::type {
+    typedef typename has_key<T>::value_type value_type;
+    auto itr = std::inserter(t, t.begin());
+
+    std::uint32_t size;
+    if (!in.read_map_size(size))
+      return false;
+
+    for (; size > 0; --size) {
+      value_type obj{};
+      if (!format(in, obj))
+        return false;
+      *itr = std::move(obj);
+    }
+    return in;
+  }
+
+  template <typename T, typename Stream>
+  static auto format_impl(Stream& in, T& t) -> typename std::enable_if<!(has_range<T>::value || has_key<T>::value), bool>::type {
+    in >> t;
+    return in;
+  }
+
+  template <typename T, typename Stream>
+  static auto format(Stream& in, T& t) -> typename std::enable_if<has_format_override<T, Stream>::value, bool>::type {
+    format_override<T, Stream>::format(in, t);
+    return in;
+  }
+
+  template <typename T, typename Stream>
+  static auto format(Stream& in, T& t) -> typename std::enable_if<!has_format_override<T, Stream>::value, bool>::type {
+    format_impl(in, t);
+    return in;
+  }
+};
+
+template <>
+struct format_override<std::string, msgpack::OutStream> {
+  template <typename Stream>
+  static void format(Stream& out, const std::string& obj) {
+    out.write_string(obj);
+  }
+};
+
+template <>
+struct format_override<std::string, msgpack::InStream> {
+  template <typename Stream>
+  static void format(Stream& in, std::string& obj) {
+    in.read_string(obj);
+  }
+};
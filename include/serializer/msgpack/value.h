@@ -0,0 +1,196 @@
+#pragma once
+
+#include <serializer/json/impl.h>
+#include <serializer/msgpack/msgpack.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace msgpack {
+
+namespace detail {
+
+// keys without a copy: strings in a contiguous buffer are interned straight from it
+inline bool read_atom(InStream& in, json::Atom& atom) {
+  std::uint32_t size;
+  if (!in.read_string_size(size))
+    return false;
+
+  if (in.contiguous()) {
+    if (in.remaining() < size) {
+      in.bad();
+      return false;
+    }
+    atom = json::Atom(in.cur, size);
+    in.cur += size;
+    return true;
+  }
+
+  std::string str;
+  if (!in.read(str, size))
+    return false;
+  atom = json::Atom(str);
+  return true;
+}
+
+}
+
+}
+
+template <>
+struct format_override<json::Value, msgpack::OutStream> {
+  template <typename Stream>
+  static void format(Stream& out, const json::Value& lazy) {
+    using namespace json;
+
+    auto& value = lazy.expanded();
+    switch(value.type) {
+      case Value::Type::Object:
+        ::format(out, value.data.object->value);
+        break;
+      case Value::Type::Array:
+        ::format(out, value.data.array->value);
+        break;
+      case Value::Type::String:
+        out.write_string(value.data.string->value);
+        break;
+      case Value::Type::Number:
+        out.write_double(value.data.number);
+        break;
+      case Value::Type::Boolean:
+        out.write_bool(value.data.boolean);
+        break;
+      default:
+        out.write_nil();
+        break;
+    }
+  }
+};
+
+template <>
+struct format_override<json::Value, msgpack::InStream> {
+  // containers announce their size, so it is reserved up front, but only up to 1024 elements:
+  // every nesting level reserves, so trusting the header, or even the bytes left, lets a small
+  // payload claim memory many times its size
+  template <typename Stream>
+  static bool format_object(Stream& in, json::Object& obj) {
+    using namespace json;
+
+    std::uint32_t size;
+    if (!in.read_map_size(size))
+      return false;
+
+    obj.reserve(std::min<std::size_t>(size, 1024));
+    for (; size > 0; --size) {
+      Atom key;
+      Value val;
+      if (!msgpack::detail::read_atom(in, key))
+        return false;
+      format(in, val);
+      if (!in)
+        return false;
+      obj.emplace(key, std::move(val));
+    }
+    return true;
+  }
+
+  template <typename Stream>
+  static bool format_array(Stream& in, json::Array& arr) {
+    using namespace json;
+
+    std::uint32_t size;
+    if (!in.read_array_size(size))
+      return false;
+
+    arr.reserve(std::min<std::size_t>(size, 1024));
+    for (; size > 0; --size) {
+      Value val;
+      format(in, val);
+      if (!in)
+        return false;
+      arr.push_back(std::move(val));
+    }
+    return true;
+  }
+
+  template <typename Stream>
+  static void format(Stream& in, json::Value& value) {
+    using namespace json;
+
+    switch (in.next_type()) {
+      case msgpack::Type::Map: {
+        Object ob;
+        if (format_object(in, ob))
+          value = std::move(ob);
+        return;
+      }
+      case msgpack::Type::Array: {
+        Array ar;
+        if (format_array(in, ar))
+          value = std::move(ar);
+        return;
+      }
+      case msgpack::Type::String:
+      case msgpack::Type::Binary: {
+        String s;
+        if (in.read_string(s))
+          value = std::move(s);
+        return;
+      }
+      case msgpack::Type::Integer:
+      case msgpack::Type::Float: {
+        Number n;
+        if (in.read_number(n))
+          value = n;
+        return;
+      }
+      case msgpack::Type::Boolean: {
+        Bool b;
+        if (in.read_bool(b))
+          value = b;
+        return;
+      }
+      case msgpack::Type::Nil:
+        in.read_nil();
+        value = Null();
+        return;
+      default:
+        // extension types have no json counterpart
+        in.bad();
+        return;
+    }
+  }
+};
+
+template <>
+struct format_override<json::Null, msgpack::OutStream> {
+  template <typename Stream>
+  static void format(Stream& out, const json::Null&) {
+    out.write_nil();
+  }
+};
+
+template <>
+struct format_override<json::Null, msgpack::InStream> {
+  template <typename Stream>
+  static void format(Stream& in, json::Null&) {
+    in.read_nil();
+  }
+};
+
+template <>
+struct format_override<json::Atom, msgpack::OutStream> {
+  template <typename Stream>
+  static void format(Stream& out, const json::Atom& atom) {
+    out.write_string(atom.str());
+  }
+};
+
+template <>
+struct format_override<json::Atom, msgpack::InStream> {
+  template <typename Stream>
+  static void format(Stream& in, json::Atom& atom) {
+    msgpack::detail::read_atom(in, atom);
+  }
+};
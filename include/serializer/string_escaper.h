@@ -1,5 +1,105 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 std::string escape_string(const std::string&);
+
+namespace escaper {
+
+// json escape sequence for c, or nullptr when c can be written as is
+inline const char* sequence(unsigned char c, bool escape_slash) {
+  static const char* const control[32] = {
+    "\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+    "\\b",     "\\t",     "\\n",     "\\u000b", "\\f",     "\\r",     "\\u000e", "\\u000f",
+    "\\u0010", "\\u0011", "\\u0012", "\\u0013", "\\u0014", "\\u0015", "\\u0016", "\\u0017",
+    "\\u0018", "\\u0019", "\\u001a", "\\u001b", "\\u001c", "\\u001d", "\\u001e", "\\u001f"
+  };
+
+  if (c < 0x20)
+    return control[c];
+  if (c == '"')
+    return "\\\"";
+  if (c == '\\')
+    return "\\\\";
+  if (c == '/' && escape_slash)
+    return "\\/";
+  return nullptr;
+}
+
+inline unsigned first_bit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long idx;
+  _BitScanForward(&idx, mask);
+  return idx;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// returns the first character in [itr, end) that needs escaping, or end
+inline const char* find(const char* itr, const char* end, bool escape_slash) {
+#if defined(__AVX2__)
+  {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i slash = _mm256_set1_epi8(escape_slash ? '/' : '"');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    for (; end - itr >= 32; itr += 32) {
+      auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(itr));
+      auto hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, slash), _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control)));
+      auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+      if (mask)
+        return itr + first_bit(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i slash = _mm_set1_epi8(escape_slash ? '/' : '"');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; end - itr >= 16; itr += 16) {
+      auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(itr));
+      auto hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, slash), _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control)));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+      if (mask)
+        return itr + first_bit(mask);
+    }
+  }
+#endif
+  for (; itr != end; ++itr) {
+    if (sequence(static_cast<unsigned char>(*itr), escape_slash))
+      return itr;
+  }
+  return end;
+}
+
+// Writes the json escaped form of [str, str + len) through sink(const char*, std::size_t).
+// Runs that need no escaping are handed to the sink in one piece.
+template <typename Sink>
+void escape(Sink&& sink, const char* str, std::size_t len, bool escape_slash = false) {
+  auto end = str + len;
+  while (str != end) {
+    auto next = find(str, end, escape_slash);
+    if (next != str)
+      sink(str, static_cast<std::size_t>(next - str));
+    if (next == end)
+      break;
+
+    auto seq = sequence(static_cast<unsigned char>(*next), escape_slash);
+    sink(seq, seq[1] == 'u' ? 6u : 2u);
+    str = next + 1;
+  }
+}
+
+}
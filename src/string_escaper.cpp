@@ -1,27 +1,10 @@
 #include <serializer/string_escaper.h>
 
 #include <string>
-#include <sstream>
-
-// http://stackoverflow.com/questions/7724448/simple-json-string-escape-for-c
-std::string escapeJsonString(const std::string& input) {
-  std::ostringstream ss;
-  for (auto iter = input.cbegin(); iter != input.cend(); iter++) {
-    switch (*iter) {
-      case '\\': ss << "\\\\"; break;
-      case '"': ss << "\\\""; break;
-      case '/': ss << "\\/"; break;
-      case '\b': ss << "\\b"; break;
-      case '\f': ss << "\\f"; break;
-      case '\n': ss << "\\n"; break;
-      case '\r': ss << "\\r"; break;
-      case '\t': ss << "\\t"; break;
-      default: ss << *iter; break;
-    }
-  }
-  return ss.str();
-}
 
 std::string escape_string(const std::string& input) {
-  return escapeJsonString(input);
+  std::string res;
+  res.reserve(input.size() + input.size() / 8);
+  escaper::escape([&](const char* str, std::size_t len) { res.append(str, len); }, input.data(), input.size(), true);
+  return res;
 }
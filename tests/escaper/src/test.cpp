@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <chrono>
 
 #include <serializer/string_escaper.h>
 #include <uber_test.hpp>
@@ -10,13 +11,48 @@ using namespace ut;
 describe(suite)
   const std::map<std::string, std::string> cases = {
     { "Hello World", "Hello World" },
-    { "{\"Goodbye\":\"World\"}", "{\\\"Goodbye\\\":\\\"World\\\"}" }
+    { "{\"Goodbye\":\"World\"}", "{\\\"Goodbye\\\":\\\"World\\\"}" },
+    { "a/b\\c", "a\\/b\\\\c" },
+    { "\b\f\n\r\t", "\\b\\f\\n\\r\\t" },
+    { std::string("\x00\x01\x1f\x7f", 4), "\\u0000\\u0001\\u001f\x7f" },
+    { "caf\xc3\xa9 \xe2\x82\xac", "caf\xc3\xa9 \xe2\x82\xac" },
+    { "0123456789abcdef0123456789abcdef\"0123456789abcdef\n", "0123456789abcdef0123456789abcdef\\\"0123456789abcdef\\n" }
   };
 
   it("Should verify all stored cases", [=]{
     for (auto& c : cases)
       assert(escape_string(c.first) == c.second);
   });
+
+  it("Should find escapes at every offset of a block", []{
+    for (std::size_t len = 1; len < 80; ++len) {
+      for (std::size_t pos = 0; pos < len; ++pos) {
+        std::string input(len, 'x');
+        input[pos] = '\x1b';
+        auto expected = input.substr(0, pos) + "\\u001b" + input.substr(pos + 1);
+        assert(escape_string(input) == expected);
+      }
+    }
+  });
+
+  it("Should leave slashes alone unless asked to escape them", []{
+    std::string res;
+    escaper::escape([&](const char* str, std::size_t len) { res.append(str, len); }, "</script>", 9);
+    assert(res == "</script>");
+  });
+
+  it("Should report escaping throughput", []{
+    std::string input;
+    while (input.size() < (16u << 20))
+      input += "The quick brown fox jumps over the lazy dog, \"twice\"\n";
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = escape_string(input);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    assert(res.size() > input.size());
+    std::cout << "escaped " << input.size() / (1024.0 * 1024.0) / elapsed << " MB/s" << std::endl;
+  });
 done(suite)
 
 int main(int argc, char* argv[]) {
@@ -1,30 +1,56 @@
 #include <uber_test.hpp>
 
+#include <cstdio>
 #include <fstream>
 
 #include <serializer/json/impl.h>
+#include <serializer/json/document.h>
+#include <serializer/json/events.h>
+#include <serializer/json/cursor.h>
+#include <serializer/json/lines.h>
+#include <serializer/json/structural.h>
+#include <serializer/json/lazy.h>
+#include <serializer/json/path.h>
+#include <serializer/json/binary.h>
+#include <serializer/json/fields.h>
 
 #include "resources.h"
 
 using namespace ut;
 using namespace json;
 
-// http://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-std::string get_file_contents(const std::string& filename)
-{
-  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
-  if (in)
-  {
-    std::string contents;
-    in.seekg(0, std::ios::end);
-    contents.resize(in.tellg());
-    in.seekg(0, std::ios::beg);
-    in.read(&contents[0], contents.size());
-    in.close();
-    return std::move(contents);
-  }
-  return "";
-}
+// records parse events as text
+struct EventLog {
+  std::string log;
+
+  void start_object() { log += "{ "; }
+  void end_object() { log += "} "; }
+  void start_array() { log += "[ "; }
+  void end_array() { log += "] "; }
+  void key(const std::string& name) { log += "key:" + name + " "; }
+  void string(const std::string& str) { log += "str:" + str + " "; }
+  void number(double val) { log += "num:" + Value(val).json() + " "; }
+  void boolean(bool val) { log += val ? "true " : "false "; }
+  void null() { log += "null "; }
+};
+
+struct Address {
+  std::string city;
+  int zip = 0;
+};
+
+SERIALIZER_FIELDS(Address, city, zip)
+
+struct Person {
+  std::string name;
+  int age = 0;
+  bool active = true;
+  std::vector<std::string> tags;
+  Address address;
+  std::vector<Address> previous;
+};
+
+SERIALIZER_FIELDS(Person, name, age, active, tags, address, previous)
 
 describe(suite)
   it("should parse a string", [] {
@@ -47,6 +73,62 @@ describe(suite)
     ut_assert(val.is<Number>());
   });
 
+  it("should follow the json number grammar", [] {
+    Value val;
+    ut_assert(val.parse("[0, -0, 1e2, 1E-2, 12.5e+1, 0.1, 123456789012345678901234567890]"));
+    ut_assert_eq(val, (Array{0, 0, 100, 0.01, 125, 0.1, 1.2345678901234568e29}));
+
+    for (auto input : {"+1", ".5", "-", "[01]", "[1.]", "[1e]", "[1.e5]"}) {
+      Value v;
+      ut_assert_eq(v.parse(input), false);
+    }
+  });
+
+  it("should parse numbers directly into typed targets", [] {
+    std::vector<std::int64_t> big;
+    InStream in1("[9007199254740993, -9223372036854775808]");
+    format(in1, big);
+    ut_assert(in1);
+    ut_assert_eq(big.size(), 2u);
+    ut_assert_eq(big[0], 9007199254740993ll);
+    ut_assert_eq(big[1], std::numeric_limits<std::int64_t>::min());
+
+    std::vector<float> floats;
+    InStream in2("[0.1, 3.4028235e38]");
+    format(in2, floats);
+    ut_assert(in2);
+    ut_assert_eq(floats[0], 0.1f);
+    ut_assert_eq(floats[1], std::numeric_limits<float>::max());
+
+    std::vector<std::uint32_t> unsigned_;
+    InStream in3("[-1]");
+    format(in3, unsigned_);
+    ut_assert(!in3);
+
+    std::vector<int> ints;
+    InStream in4("[2147483648]");
+    format(in4, ints);
+    ut_assert(!in4);
+  });
+
+  it("should read other types through std::istream", [] {
+    std::vector<unsigned char> chars;
+    InStream in1("[a, b ,c]");
+    format(in1, chars);
+    ut_assert(in1);
+    ut_assert_eq(std::string(chars.begin(), chars.end()), "abc");
+
+    std::string text = "[";
+    for (int i = 0; i < 100000; ++i)
+      text += i ? ",x" : "x";
+    text += "]";
+    chars.clear();
+    InStream in2(text);
+    format(in2, chars);
+    ut_assert(in2);
+    ut_assert_eq(chars.size(), 100000u);
+  });
+
   it("should parse a null", [] {
     std::stringstream str;
     str << "null";
@@ -97,6 +179,37 @@ describe(suite)
     ut_assert(val.is<Array>());
   });
 
+  it("should parse values surrounded by whitespace", [] {
+    Value val;
+    ut_assert(val.parse(" \t\n[ true , false, null, \"x\", -1.5e3, { \"k\" : [ ] } ]\n"));
+    ut_assert_eq(val, (Array{true, false, nullptr, "x", -1500, Object{{"k", Array{}}}}));
+  });
+
+  it("should fail to parse a truncated literal", [] {
+    Value val;
+    ut_assert_eq(val.parse("[tru]"), false);
+    ut_assert(val.is<Null>());
+  });
+
+  it("should parse from a bounded character range", [] {
+    const std::string input = "[1, 2, \"three\"]trailing";
+    Value val;
+    ut_assert(val.parse(input.data(), input.find(']') + 1));
+    ut_assert_eq(val, (Array{1, 2, "three"}));
+    ut_assert_eq(val.parse(input.data(), input.find(']')), false);
+  });
+
+  it("should read consecutive values from one stream", [] {
+    std::stringstream str;
+    str << "[1] {\"a\": true}";
+
+    Value first, second;
+    str >> first >> second;
+
+    ut_assert_eq(first, Array{1});
+    ut_assert_eq(second["a"], true);
+  });
+
   it("should create an Array", [] {
     std::stringstream str;
     str << "[]";
@@ -144,6 +257,98 @@ describe(suite)
     ut_assert_neq(fill.as<Object>(), v, "Should not be equivalent");
   });
 
+  it("should escape strings when serializing", [] {
+    Value v = {{"quote\"key", "line\nbreak\t\x01"}};
+    ut_assert_eq(v.json(), "{\"quote\\\"key\":\"line\\nbreak\\t\\u0001\"}");
+  });
+
+  it("should unescape strings when parsing", [] {
+    const std::string input = R"({"k\"ey": "tab\there \"quoted\" \\ \/ é€ 😀 0123456789abcdef0123456789abcdef"})";
+    const std::string expected = "tab\there \"quoted\" \\ / \xc3\xa9\xe2\x82\xac \xf0\x9f\x98\x80 0123456789abcdef0123456789abcdef";
+
+    Value v;
+    ut_assert(v.parse(input));
+    ut_assert_eq(v["k\"ey"], expected);
+
+    std::stringstream str(input);
+    Value v2;
+    str >> v2;
+    ut_assert_eq(v2, v);
+
+    Value v3;
+    ut_assert(v3.parse(v.json()));
+    ut_assert_eq(v3, v);
+  });
+
+  it("should reject malformed escapes", [] {
+    Value v;
+    ut_assert_eq(v.parse(R"(["\q"])"), false);
+    ut_assert_eq(v.parse(R"(["\u12"])"), false);
+    ut_assert_eq(v.parse(R"(["\ud83d"])"), false);
+    ut_assert_eq(v.parse(R"(["\ude00"])"), false);
+  });
+
+  it("should write numbers in their shortest round trip form", [] {
+    Array numbers = {0.1, 1.5, -2, 1e21, 1e300, 0.000001, 1e-7, 123456.789, 9007199254740993.0, 5e-324};
+    ut_assert_eq(Value(numbers).json(), "[0.1,1.5,-2,1e+21,1e+300,0.000001,1e-7,123456.789,9007199254740992,5e-324]");
+
+    Value parsed;
+    ut_assert(parsed.parse(Value(numbers).json()));
+    ut_assert_eq(parsed, numbers);
+  });
+
+  it("should write non-finite numbers as null", [] {
+    Array numbers = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity()};
+    ut_assert_eq(Value(numbers).json(), "[null,null]");
+  });
+
+  it("should write through every sink", [] {
+    Value val = {{"key", Array{1, "two", 3.5, true, nullptr}}};
+    auto expected = val.json();
+    ut_assert_eq(expected, R"({"key":[1,"two",3.5,true,null]})");
+
+    std::string str = "prefix ";
+    {
+      OutStream out(str);
+      format(out, val);
+    }
+    ut_assert_eq(str, "prefix " + expected);
+
+    std::stringstream ss;
+    ss << val;
+    ut_assert_eq(ss.str(), expected);
+
+    // std::ostreams see each write straight away
+    std::stringstream direct;
+    OutStream out(direct);
+    format(out, val);
+    ut_assert_eq(direct.str(), expected);
+    out << 1.5 << 'x';
+    ut_assert_eq(direct.str(), expected + "1.5x");
+
+    std::string collected;
+    {
+      OutStream out(OutStream::Sink([&](const char* data, std::size_t len) { collected.append(data, len); }));
+      format(out, val);
+      ut_assert(collected.empty());
+      out.flush();
+      ut_assert_eq(collected, expected);
+    }
+
+    // larger than the internal buffer
+    std::string big(OutStream::buffer_size * 3, 'x');
+    ut_assert_eq(Value(big).json(), "\"" + big + "\"");
+    collected.clear();
+    {
+      OutStream out(OutStream::Sink([&](const char* data, std::size_t len) { collected.append(data, len); }));
+      out << "[";
+      format(out, big);
+      out << ",";
+      out << 42 << "]";
+    }
+    ut_assert_eq(collected, "[\"" + big + "\",42]");
+  });
+
   it("should create a new object", [] {
     auto num = 100;
     auto str = "sample key";
@@ -186,14 +391,26 @@ describe(suite)
     ut_assert_throws(obj["data"][2].as<Value>(), AccessException);
   });
 
-  it("should demonstrate value reference semantics", [] {
+  it("should demonstrate value semantics", [] {
     Value v = {
       {"Hello", "World"}
     };
     Value v2 = v;
     v2["test"] = "hi";
 
-    ut_assert_eq(v, v2);
+    ut_assert_neq(v, v2);
+    ut_assert(!v.has("test"));
+  });
+
+  it("should store scalars inline", [] {
+    ut_assert(sizeof(Value) <= 16);
+
+    Value v = 1.5;
+    Value v2 = v;
+    v2.as<Number>() = 2;
+
+    ut_assert_eq(v, 1.5);
+    ut_assert_eq(v2, 2);
   });
 
   it("should clone a value", [] {
@@ -216,6 +433,74 @@ describe(suite)
     ut_assert_neq(v, v2);
   });
 
+  it("should move values into place", [] {
+    Array arr = {1, "two", Array{3}};
+    auto elements = arr.data();
+    Value v1(std::move(arr));
+    const Value& cv1 = v1;
+    ut_assert_eq(cv1.as<Array>().data(), elements);
+
+    Value v2 = std::move(v1);
+    ut_assert(v1.is<Null>());
+    ut_assert_eq(&v2.as<Array>()[0], elements);
+
+    Value v3;
+    v3 = std::move(v2);
+    v3 = std::move(v3);
+    ut_assert_eq(v3, (Array{1, "two", Array{3}}));
+
+    v3 = std::move(v3[2].as<Value>());
+    ut_assert_eq(v3, Array{3});
+
+    auto obj = Value::make_object("id", 1, "tags", Value::make_array("x", 2), "name", std::string("n"));
+    ut_assert_eq(obj.json(), R"({"id":1,"tags":["x",2],"name":"n"})");
+
+    Value list;
+    list.push_back(1);
+    list.push_back(std::move(obj))["id"] = 2;
+    ut_assert(obj.is<Null>());
+    ut_assert_eq(list.json(), R"([1,{"id":2,"tags":["x",2],"name":"n"}])");
+    ut_assert_throws(Value("x").push_back(1), TypeException);
+  });
+
+  it("should copy only the edited path on write", [] {
+    Value original;
+    ut_assert(original.parse(R"({"a": {"b": [1, 2], "c": "x"}, "d": [3]})"));
+    Value copy = original.clone();
+    const Value& before = original;
+    const Value& after = copy;
+    ut_assert_eq(&after.as<Object>(), &before.as<Object>());
+
+    copy["a"]["b"][0] = 5;
+    ut_assert_eq(before["a"]["b"][0].as<Number>(), 1);
+    ut_assert_eq(after["a"]["b"][0].as<Number>(), 5);
+    ut_assert_neq(&after["a"]["b"].as<Array>(), &before["a"]["b"].as<Array>());
+    ut_assert_eq(&after["a"]["c"].as<String>(), &before["a"]["c"].as<String>());
+    ut_assert_eq(&after["d"].as<Array>(), &before["d"].as<Array>());
+
+    original["d"].as<Array>().push_back(4);
+    ut_assert_eq(before["d"].as<Array>().size(), 2);
+    ut_assert_eq(after["d"].as<Array>().size(), 1);
+  });
+
+  it("should not share nodes handed out for changes with later copies", [] {
+    Value v = Array{1, 2, 3};
+    auto& arr = v.as<Array>();
+    Value cloned = v.clone();
+    Value copied = v;
+    arr.push_back(4);
+    ut_assert_eq(v.as<Array>().size(), 4);
+    ut_assert_eq(cloned.as<Array>().size(), 3);
+    ut_assert_eq(copied.as<Array>().size(), 3);
+
+    Value root = Object{{"a", Object{{"b", 1}}}};
+    auto& a = root.lookup("a");
+    Value before = root;
+    a.as<Object>()["b"] = 2;
+    ut_assert_eq(root["a"]["b"].as<Number>(), 2);
+    ut_assert_eq(before["a"]["b"].as<Number>(), 1);
+  });
+
   it("should fail to coerce a number field to a string", [] {
     Value v = {
       {"test", 0}
@@ -330,6 +615,679 @@ describe(suite)
     ut_assert_throws(v["example"]["test"].as<String>(), TypeException);
   });
 
+  it("should parse a document into its arena", [] {
+    Document doc;
+    ut_assert(doc.parse(text));
+    ut_assert_eq(doc.root()["glossary"]["GlossDiv"]["GlossList"]["GlossEntry"]["GlossTerm"], "Standard Generalized Markup Language");
+    ut_assert(doc.arena.capacity() > 0);
+
+    Value copy = doc.root()["glossary"]["GlossDiv"].as<Value>().deep_clone();
+    doc.clear();
+
+    ut_assert_eq(doc.arena.capacity(), 0u);
+    ut_assert_eq(copy["title"], "S");
+    ut_assert_eq(copy["GlossList"]["GlossEntry"]["GlossDef"]["GlossSeeAlso"][1], "XML");
+  });
+
+  it("should release heap values stored into a document", [] {
+    Document doc;
+    ut_assert(doc.parse(R"({"a": {"b": [1, "two"]}})"));
+    doc.root()["a"]["c"] = std::string(100, 'x');
+    doc.root()["a"]["d"] = Array{std::string(100, 'y'), Object{{"e", 1}}};
+    doc.root()["a"]["b"].as<Array>().push_back(std::string(100, 'z'));
+
+    Value copy = doc.root()["a"];
+    Value element = doc.root()["a"]["b"];
+    doc.clear();
+
+    ut_assert_eq(copy["c"].as<String>().size(), 100);
+    ut_assert_eq(copy["d"][1]["e"], 1);
+    ut_assert_eq(element[1], "two");
+    ut_assert_eq(element[2].as<String>(), std::string(100, 'z'));
+  });
+
+  it("should copy values moved out of a document onto the heap", [] {
+    Document doc;
+    ut_assert(doc.parse(R"({"a": {"b": [1, "two"]}, "c": ["three", {"d": 4}]})"));
+
+    Value moved = std::move(doc.root().lookup("a"));
+    Value assigned;
+    assigned = std::move(doc.root().lookup("c"));
+    doc.clear();
+
+    ut_assert_eq(moved["b"][1], "two");
+    ut_assert_eq(assigned[0], "three");
+    ut_assert_eq(assigned[1]["d"], 4);
+  });
+
+  it("should report parse events without building a value", [] {
+    auto text = R"( {"a": [1, -2.5e1, "x\\ty"], "b": {}, "c": [], "d": {"e": [true, false, null]}} )";
+    auto expected = "{ key:a [ num:1 num:-25 str:x\\ty ] key:b { } key:c [ ] key:d { key:e [ true false null ] } } ";
+
+    EventLog events;
+    ut_assert(parse_events(text, events));
+    ut_assert_eq(events.log, expected);
+
+    std::stringstream str(text);
+    EventLog streamed;
+    ut_assert(parse_events(str, streamed));
+    ut_assert_eq(streamed.log, expected);
+
+    for (auto bad : {"[1,]", "{\"a\" 1}", "{\"a\":1,}", "{1:2}", "[1 2]", "[tru]", "[\"open", "]"}) {
+      EventLog failed;
+      ut_assert(!parse_events(bad, failed));
+    }
+
+    // handlers only define the events they need
+    struct Sum {
+      double total = 0;
+      void number(double val) { total += val; }
+    } sum;
+    ut_assert(parse_events(text, sum));
+    ut_assert_eq(sum.total, -24);
+  });
+
+  it("should pull array elements one at a time", [] {
+    auto text = R"({"type": "FeatureCollection", "skip": [{"a": [1, {}]}, "]"],
+                    "features": [{"id": 1}, {"id": 2, "tags": ["x"]}, {"id": 3}]})";
+
+    ArrayCursor features(text, "/features");
+    Value feature;
+    std::vector<Number> ids;
+    while (features.next(feature))
+      ids.push_back(feature["id"].as<Number>());
+    ut_assert(!features.failed());
+    ut_assert_eq(ids, std::vector<Number>({1, 2, 3}));
+    ut_assert_eq(features.index(), 3);
+
+    std::stringstream str(R"({"a": [0, {"b/c": [[1, 2], [3, 4], []]}]})");
+    ArrayCursor nested(str, "/a/1/b~1c");
+    std::vector<int> pair;
+    std::vector<std::vector<int>> pairs;
+    while (nested.next(pair))
+      pairs.push_back(pair);
+    ut_assert(!nested.failed());
+    ut_assert_eq(pairs.size(), 3);
+    ut_assert_eq(pairs[1], std::vector<int>({3, 4}));
+
+    ArrayCursor empty("{\"features\": []}", "/features");
+    ut_assert(!empty.next(feature));
+    ut_assert(!empty.failed());
+
+    ArrayCursor missing(text, "/missing");
+    ut_assert(!missing.next(feature));
+    ut_assert(missing.failed());
+
+    for (auto index : {"/skip/99999999999999999999999", "/skip/01", "/skip/-1", "/skip/9"}) {
+      ArrayCursor bad_index(text, index);
+      ut_assert(!bad_index.next(feature));
+      ut_assert(bad_index.failed());
+    }
+
+    ArrayCursor truncated("{\"features\": [1, 2", "/features");
+    ut_assert(truncated.next(feature));
+    ut_assert(truncated.next(feature));
+    ut_assert(!truncated.next(feature));
+    ut_assert(truncated.failed());
+  });
+
+  it("should parse json lines in parallel and in order", [] {
+    std::string text = "{\"id\": 0}\r\n\n  \n[1, 2]\n{\"id\": \n\"x\" 5\n";
+    auto small = parse_lines(text);
+    ut_assert_eq(small.size(), 4);
+    ut_assert(small[0].ok && small[0].value["id"] == 0);
+    ut_assert_eq(small[1].line, 4);
+    ut_assert_eq(small[1].value, Array({1, 2}));
+    ut_assert(!small[2].ok && small[2].line == 5);
+    ut_assert(!small[3].ok && small[3].line == 6);
+    ut_assert_eq(small[1].offset, 15);
+    ut_assert(small[1].error.empty());
+    ut_assert_eq(small[2].offset, 22);
+    ut_assert_eq(small[3].offset, 30);
+    ut_assert_eq(small[3].error, "Malformed json on line 6 near byte 34: \"x\" 5");
+
+    std::string big;
+    for (int i = 0; i < 20000; ++i)
+      big += i % 1000 == 999 ? "{broken\n" : "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a\", \"b\"]}\n";
+
+    auto lines = parse_lines(big, 4);
+    ut_assert_eq(lines.size(), 20000);
+    std::size_t errors = 0;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      ut_assert_eq(lines[i].line, i + 1);
+      if (!lines[i].ok)
+        ++errors;
+      else
+        ut_assert(lines[i].value["id"] == static_cast<int>(i));
+    }
+    ut_assert_eq(errors, 20);
+
+    std::size_t expected = 1;
+    parse_lines(big, [&](ParsedLine& res) {
+      ut_assert_eq(res.line, expected++);
+      ut_assert_eq(res.ok, lines[res.line - 1].ok);
+    }, 4);
+    ut_assert_eq(expected, 20001);
+  });
+
+  it("should parse through a structural index", [] {
+    std::vector<std::string> docs = {
+      "[]", " {} ", "7", "\"str\"", "[true, false, null, -1.5e3]",
+      R"({"a": {"b": [1, {"c": "d"}]}, "e": "\"quoted\" \\", "f": []})",
+      // escapes and backslash runs straddling 64 byte blocks
+      "[\"" + std::string(60, 'x') + "\\\\\", \"" + std::string(61, 'y') + "\\\"\\\\\", 1]"
+    };
+    for (const auto& doc : docs) {
+      Value indexed, serial;
+      ut_assert(parse_parallel(doc, indexed, 1));
+      ut_assert(serial.parse(doc));
+      ut_assert_eq(indexed, serial);
+    }
+
+    for (auto bad : {"", "[1,]", "{\"a\":1,}", "[1 2]", "{\"a\" 1}", "[\"open]", "[1]]", "[1} ", "{\"a\":}", "[tru]", "[1] x", "[1x]"}) {
+      Value val;
+      ut_assert(!parse_parallel(bad, val, 1));
+    }
+
+    // large enough to be split across threads
+    std::string big = "{\"features\": [";
+    for (int i = 0; i < 20000; ++i)
+      big += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"name\": \"f\\u00e9\", \"tags\": [1, 2]}";
+    big += "]}";
+
+    Value indexed, serial;
+    ut_assert(parse_parallel(big, indexed, 4));
+    ut_assert(serial.parse(big));
+    ut_assert_eq(indexed, serial);
+    ut_assert(!parse_parallel(big.substr(0, big.size() - 2) + ",]}", indexed, 4));
+  });
+
+  it("should parse a file through a memory mapping", [] {
+    auto text = R"({"name": "mapped", "values": [1, 2, 3], "nested": {"escaped": "a\nb"},
+                    "long": "a string too long to be stored inline", "long_escaped": "a string\twith an escape in it"})";
+    {
+      std::ofstream out("mapped_test.json", std::ios::binary);
+      out << text;
+    }
+
+    Value expected;
+    ut_assert(expected.parse(text));
+
+    Value val;
+    ut_assert(val.parse_file("mapped_test.json"));
+    ut_assert_eq(val, expected);
+
+    Document doc;
+    ut_assert(doc.open("mapped_test.json"));
+    ut_assert_eq(doc.root(), expected);
+
+    // long strings without escapes are read from the mapping
+    const Value& root = doc.root();
+    auto& long_text = root.lookup("long");
+    ut_assert_eq(long_text.type, Value::Type::Lazy);
+    ut_assert(long_text.is<String>());
+    auto view = long_text.view();
+    ut_assert_eq(view.str(), "a string too long to be stored inline");
+    ut_assert_eq(long_text.type, Value::Type::Lazy);
+    ut_assert_eq(long_text.as<String>(), view.str());
+    ut_assert(long_text.view().data == view.data);
+    ut_assert_eq(root.lookup("long_escaped").type, Value::Type::String);
+    ut_assert_eq(root.lookup("long_escaped").view().str(), "a string\twith an escape in it");
+    ut_assert_eq(root.lookup("name").type, Value::Type::String);
+    ut_assert_throws(root.lookup("values").view(), TypeException);
+    ut_assert_eq(root.json(), expected.json());
+
+    Value copy = root;
+    doc.root()["long"] = "changed";
+    ut_assert_eq(doc.root()["long"].as<String>(), "changed");
+    doc.clear();
+    ut_assert_eq(copy, expected);
+
+    std::remove("mapped_test.json");
+    ut_assert(!val.parse_file("mapped_test.json"));
+    ut_assert(!doc.open("mapped_test.json"));
+  });
+
+  it("should parse lazily only what is read", [] {
+    auto text = R"({"meta": {"name": "lazy", "tags": ["a", "b]"]}, "features": [{"id": 1}, {"id": 2}],
+                    "broken": {"x": [1, 2,, 3]}, "count": 3})";
+
+    LazyDocument doc;
+    ut_assert(doc.parse(text));
+    ut_assert_eq(doc.root().type, Value::Type::Lazy);
+
+    const Value& root = doc.root();
+    ut_assert_eq(root["meta"]["name"].as<String>(), "lazy");
+    ut_assert_eq(root["meta"]["tags"][1].as<String>(), "b]");
+    ut_assert_eq(root["count"].as<Number>(), 3);
+    ut_assert_eq(root.lookup("features").type, Value::Type::Lazy);
+    ut_assert_eq(root.lookup("broken").type, Value::Type::Lazy);
+    ut_assert_eq(root["missing"].defaultTo(5), 5);
+
+    doc.root()["features"][1]["id"] = 20;
+    ut_assert_eq(root["features"][1]["id"].as<Number>(), 20);
+    ut_assert_eq(root["features"][0].as<Value>(), Value({{"id", 1}}));
+
+    ut_assert_throws(root["broken"]["x"].as<Array>(), ParseException);
+    ut_assert(!doc.parse("{\"open\": [1, 2}"));
+
+    // readers of one document may parse its parts at the same time
+    std::string items = "[";
+    for (int i = 0; i < 200; ++i)
+      items += std::string(i ? "," : "") + "{\"id\": " + std::to_string(i) + ", \"tags\": [\"x\", [" + std::to_string(i) + "]]}";
+    items += "]";
+    LazyDocument shared;
+    ut_assert(shared.parse(items));
+    const Value& list = shared.root();
+    std::atomic<int> sum(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+      readers.emplace_back([&] {
+        int local = 0;
+        for (std::size_t idx = 0; idx < 200; ++idx)
+          local += static_cast<int>(list[idx]["tags"][1][0].as<Number>());
+        sum += local;
+      });
+    }
+    for (auto& reader : readers)
+      reader.join();
+    ut_assert_eq(sum.load(), 4 * 199 * 100);
+  });
+
+  it("should evaluate compiled paths", [] {
+    Value val;
+    ut_assert(val.parse(R"({"features": [{"properties": {"name": "first", "a/b": 1, "0": "zero"}}], "count": 2})"));
+
+    const Path name("/features/0/properties/name");
+    ut_assert_eq(name.get<String>(val), "first");
+    ut_assert_eq(Path("/features/0/properties/a~1b").get<Number>(val), 1);
+    ut_assert_eq(Path({"features", 0, "properties", "0"}).get<String>(val), "zero");
+    ut_assert_eq(Path("").find(val), &val);
+    ut_assert_eq(Path("/features/1/properties").find(val), nullptr);
+    ut_assert_eq(Path("/features/01").find(val), nullptr);
+    ut_assert_eq(Path("/count").get_or<Number>(val, 5), 2);
+    ut_assert_eq(Path("/missing").get_or<Number>(val, 5), 5);
+    ut_assert_throws(Path("/count/x").get<Number>(val), AccessException);
+    ut_assert_eq(Path({"a/b", "c~d"}).str(), "/a~1b/c~0d");
+
+    Path("/features/0/properties/name").set(val, "renamed");
+    Path("/created/list/2").set(val, true);
+    ut_assert_eq(name.get<String>(val), "renamed");
+    ut_assert_eq(val["created"]["list"].as<Array>().size(), 3);
+    ut_assert(Path("/created/list/2").get<Bool>(val));
+
+    // existing values are not replaced by the containers a step needs
+    auto before = val;
+    ut_assert_throws(Path("/features/x").set(val, 1), TypeException);
+    ut_assert_throws(Path("/count/0").set(val, 1), TypeException);
+    ut_assert_throws(Path("/features/0/properties/name/x").set(val, 1), TypeException);
+    ut_assert_eq(val, before);
+    Path("/created/list/1/x").set(val, 1);
+    ut_assert_eq(val["created"]["list"][1]["x"].as<Number>(), 1);
+
+    // the value set may live in the array the path extends
+    Value root = Object{{"a", Array{Object{{"b", 1}}}}};
+    Path({"a", 7}).set(root, static_cast<const Value&>(root)["a"][0]);
+    ut_assert_eq(root["a"].as<Array>().size(), 8);
+    ut_assert_eq(root["a"][7]["b"].as<Number>(), 1);
+  });
+
+  it("should intern object keys", [] {
+    Value v1, v2;
+    ut_assert(v1.parse(R"([{"shared key": 1}, {"shared key": 2, "escaped": 3}])"));
+    ut_assert(v2.parse(R"({"shared key": 4, "escaped": 5})"));
+
+    const auto& first = v1[0].as<Object>().begin()->first;
+    const auto& second = v2.as<Object>().find("shared key")->first;
+    ut_assert_eq(first.c_str(), second.c_str());
+    ut_assert(first == "shared key");
+    ut_assert(Atom("escaped") == Atom(std::string("escaped")));
+    ut_assert_eq(v1[1]["escaped"].as<Number>(), 3);
+
+    Atom atom;
+    ut_assert(!Atom::find("never interned", atom));
+    ut_assert(!v2.has("never interned"));
+    ut_assert(!Atom::find("never interned", atom));
+    ut_assert(Atom::find("shared key", atom) && atom == first);
+  });
+
+  // runs after the tests that rely on new keys being interned, as it fills the table for good
+  it("should keep keys the atom table does not take", [] {
+    std::string long_key(detail::AtomTable::max_atom_size + 1, 'k');
+    Atom a1(long_key), a2(long_key);
+    ut_assert(!a1.data->interned);
+    ut_assert(a1.data != a2.data);
+    ut_assert(a1 == a2);
+    ut_assert(a1 != Atom("k"));
+
+    Value v;
+    ut_assert(v.parse("{\"" + long_key + "\": 1, \"short\": 2}"));
+    ut_assert(v.has(long_key));
+    ut_assert_eq(v[long_key].as<Number>(), 1);
+    v[long_key] = 3;
+    ut_assert_eq(v.as<Object>().size(), 2);
+    ut_assert_eq(v.as<Object>().find(a2)->second.as<Number>(), 3);
+
+    for (std::size_t i = 0; i < detail::AtomTable::max_atoms; ++i)
+      Atom(std::string("filler ") + std::to_string(i));
+    ut_assert_eq(detail::AtomTable::instance().size(), detail::AtomTable::max_atoms);
+
+    Object obj;
+    for (int i = 0; i < 40; ++i)
+      obj[Atom("overflow " + std::to_string(i))] = i;
+    ut_assert(!obj.begin()->first.data->interned);
+    ut_assert_eq(obj.size(), 40);
+    ut_assert_eq(obj[Atom("overflow 7")].as<Number>(), 7);
+    ut_assert(obj[Atom("short")].is<Null>());
+    ut_assert_eq(obj.size(), 41);
+
+    Value parsed;
+    ut_assert(parsed.parse(R"({"overflow 3": "x", "short": true})"));
+    ut_assert(parsed.has("overflow 3"));
+    ut_assert(!parsed.has("overflow 4"));
+    ut_assert(parsed["short"].as<Bool>());
+    ut_assert_eq(hash(Value(obj)), hash(Value(obj)));
+  });
+
+  it("should keep object members in insertion order", [] {
+    Value v;
+    ut_assert(v.parse(R"({"z": 1, "a": 2, "m": 3, "a": 4})"));
+    ut_assert_eq(v.json(), R"({"z":1,"a":2,"m":3})");
+
+    Object obj;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+      auto key = "key" + std::to_string(99 - i);
+      obj[key] = i;
+      expected += (i ? ",\"" : "{\"") + key + "\":" + std::to_string(i);
+    }
+    ut_assert_eq(Value(obj).json(), expected + "}");
+    ut_assert_eq(obj.size(), 100);
+    ut_assert_eq(obj.at("key0").as<Number>(), 99);
+    ut_assert_eq(obj.count("key100"), 0);
+
+    ut_assert_eq(obj.erase("key50"), 1);
+    ut_assert_eq(obj.erase("key50"), 0);
+    ut_assert_eq(obj.size(), 99);
+    ut_assert_eq(obj["key49"].as<Number>(), 50);
+    ut_assert_eq((obj.begin() + 50)->first, "key48");
+
+    Object copy = obj;
+    ut_assert_eq(copy, obj);
+    copy["key0"] = 0;
+    ut_assert_neq(copy, obj);
+  });
+
+  it("should keep references to object members while inserting", [] {
+    Object obj;
+    obj["Children"] = Array{1, "hi"};
+    obj["Hello"] = 0;
+    auto& children = obj["Children"];
+    for (int i = 0; i < 100; ++i) {
+      obj["test"] = obj["Children"];
+      obj["key" + std::to_string(i)] = obj["Hello"];
+    }
+    ut_assert_eq(&obj["Children"], &children);
+    ut_assert_eq(obj["test"], children);
+    ut_assert_eq(obj.size(), 103);
+
+    obj.erase("key0");
+    ut_assert_eq(&obj["Children"], &children);
+    obj["reused"] = obj["Children"];
+    ut_assert_eq(obj["reused"][1].as<String>(), "hi");
+
+    Value v = Object{{"a", 1}};
+    for (int i = 0; i < 40; ++i)
+      v.set("b" + std::to_string(i), v["a"].as<Value>());
+    ut_assert_eq(v["b39"].as<Number>(), 1);
+    v["c"] = v["a"].as<Value>();
+    ut_assert_eq(v["c"].as<Number>(), 1);
+  });
+
+  it("should compare objects regardless of member order", [] {
+    Value v1, v2;
+    ut_assert(v1.parse(R"({"a": 1, "b": [1, {"c": null}], "d": "x"})"));
+    ut_assert(v2.parse(R"({"d": "x", "b": [1, {"c": null}], "a": 1})"));
+    ut_assert(equivalent(v1, v2));
+    ut_assert(parallel_equivalent(v1, v2, 4));
+
+    Array a1, a2;
+    for (int i = 0; i < 5000; ++i) {
+      a1.push_back(Object{{"id", i}, {"tags", Array{"x", i % 7}}});
+      a2.push_back(Object{{"tags", Array{"x", i % 7}}, {"id", i}});
+    }
+    Value big1 = Object{{"items", a1}}, big2 = Object{{"items", a2}};
+    ut_assert(equivalent(big1, big2));
+    ut_assert(parallel_equivalent(big1, big2, 4));
+
+    a2[4321] = Object{{"id", 4321}, {"tags", Array{"y", 4321 % 7}}};
+    big2 = Object{{"items", a2}};
+    ut_assert(!equivalent(big1, big2));
+    ut_assert(!parallel_equivalent(big1, big2, 4));
+    ut_assert(!parallel_equivalent(big1, Value(Object{{"items", Array{}}}), 4));
+  });
+
+  it("should hash values structurally", [] {
+    Value v1, v2;
+    ut_assert(v1.parse(R"({"a": [1, "x", {"b": null}], "c": {"d": true, "e": -0.0}})"));
+    ut_assert(v2.parse(R"({"c": {"e": 0, "d": true}, "a": [1, "x", {"b": null}]})"));
+    ut_assert_eq(hash(v1), hash(v2));
+    ut_assert_eq(std::hash<Value>()(v1), hash(v2));
+    ut_assert_neq(hash(Value(Array{1, 2})), hash(Value(Array{2, 1})));
+    ut_assert_neq(hash(Value("1")), hash(Value(1)));
+
+    auto before = hash(v1);
+    v1["c"]["d"] = false;
+    ut_assert_neq(hash(v1), before);
+    v1["c"].as<Object>()["d"] = true;
+    ut_assert_eq(hash(v1), before);
+
+    Path("/a/2/b").set(v1, 1);
+    ut_assert_neq(hash(v1), before);
+    Path("/a/2/b").get<Value>(v1) = nullptr;
+    ut_assert_eq(hash(v1), before);
+
+    v1.set("f", 1);
+    ut_assert_neq(hash(v1), before);
+
+    // changes through references kept from a mutable access
+    Value v = Object{{"a", Array{1, 2}}};
+    Object& o = v.as<Object>();
+    auto first = hash(v);
+    o["x"] = 1;
+    ut_assert_neq(hash(v), first);
+    ut_assert_eq(hash(v), hash(Value(Object{{"a", Array{1, 2}}, {"x", 1}})));
+
+    Array& a = o["a"].as<Array>();
+    auto second = hash(v);
+    a.push_back(3);
+    ut_assert_neq(hash(v), second);
+    o["s"] = "text";
+    String& str = o["s"].as<String>();
+    auto third = hash(v);
+    str = "changed";
+    ut_assert_neq(hash(v), third);
+  });
+
+  it("should read binary documents in place", [] {
+    Value val;
+    ut_assert(val.parse(R"({"name": "binary", "count": 3, "ok": true, "none": null,
+                            "records": [{"id": 1, "name": "a"}, {"id": 2, "name": "b"}],
+                            "text": "line\nbreak", "empty": {}, "ratio": 0.5, "big": -1e10})"));
+    for (int i = 0; i < 100; ++i)
+      val["wide"]["key" + std::to_string(i)] = i;
+
+    auto bytes = to_binary(val);
+    BinaryDocument doc;
+    ut_assert(doc.parse(bytes));
+
+    auto root = doc.root();
+    ut_assert(root.is<Object>());
+    ut_assert_eq(root["name"].as<String>(), "binary");
+    ut_assert_eq(root["count"].as<Number>(), 3);
+    ut_assert_eq(root["ratio"].as<Number>(), 0.5);
+    ut_assert_eq(root["big"].as<Number>(), -1e10);
+    ut_assert(root["ok"].as<Bool>());
+    ut_assert(root["none"].is<Null>());
+    ut_assert_eq(std::string(root["text"].as<const char*>()), "line\nbreak");
+    ut_assert_eq(root["records"].size(), 2);
+    ut_assert_eq(root["records"][1]["name"].as<String>(), "b");
+    ut_assert_eq(root["empty"].size(), 0);
+    ut_assert(!root["empty"].has("name"));
+    for (int i = 0; i < 100; ++i)
+      ut_assert_eq(root["wide"]["key" + std::to_string(i)].as<Number>(), i);
+    ut_assert(!root["wide"].has("key100"));
+
+    std::vector<std::string> keys;
+    for (auto itr = root.begin(); itr != root.end(); ++itr)
+      keys.push_back(itr.key().as<String>());
+    ut_assert_eq(keys.size(), 10);
+    ut_assert_eq(keys.front(), "name");
+    ut_assert_eq(keys.back(), "wide");
+
+    Number sum = 0;
+    for (auto record : root["records"])
+      sum += record["id"].as<Number>();
+    ut_assert_eq(sum, 3);
+
+    ut_assert_throws(root["missing"], AccessException);
+    ut_assert_throws(root["records"][2], AccessException);
+    ut_assert_throws(root["name"].as<Number>(), TypeException);
+    ut_assert_throws(root["count"][0], TypeException);
+
+    // keys are stored once and shared between objects
+    ut_assert_eq(bytes.find("records"), bytes.rfind("records"));
+    ut_assert_eq(bytes.find("name"), bytes.rfind("name"));
+
+    ut_assert_eq(root.to_value(), val);
+    ut_assert_eq(to_binary(root.to_value()), bytes);
+  });
+
+  it("should map binary documents from files and reject corrupt ones", [] {
+    Value val = Object{{"list", Array{1, "two", Array{}}}, {"name", "mapped"}};
+    auto bytes = to_binary(val);
+    {
+      std::ofstream out("mapped_test.jsonb", std::ios::binary);
+      out << bytes;
+    }
+
+    BinaryDocument doc;
+    ut_assert(doc.open("mapped_test.jsonb"));
+    ut_assert_eq(doc.root()["list"][1].as<String>(), "two");
+    ut_assert_eq(doc.root().to_value(), val);
+    doc.clear();
+    std::remove("mapped_test.jsonb");
+    ut_assert(!doc.open("mapped_test.jsonb"));
+
+    ut_assert(!doc.parse(bytes.substr(0, bytes.size() - 1)));
+    ut_assert(!doc.parse("JSNB"));
+    auto bad = bytes;
+    bad[0] = 'X';
+    ut_assert(!doc.parse(bad));
+
+    // an element offset pointing back at its own array
+    auto list = doc.parse(bytes) ? doc.root()["list"] : BinaryView();
+    ut_assert(list.is<Array>());
+    std::uint32_t list_pos = 0;
+    for (std::uint32_t pos = 16; pos < bytes.size() && !list_pos; ++pos)
+      if (bytes[pos] == static_cast<char>(detail::BinaryTag::Array) && bytes[pos + 1] == 3)
+        list_pos = pos;
+    bad = bytes;
+    std::memcpy(&bad[list_pos + 5], &list_pos, 4);
+    ut_assert(doc.parse(bad));
+    ut_assert_throws(doc.root().to_value(), ParseException);
+
+    bad = bytes;
+    std::uint32_t past_end = static_cast<std::uint32_t>(bytes.size()) + 100;
+    std::memcpy(&bad[list_pos + 9], &past_end, 4);
+    ut_assert(doc.parse(bad));
+    ut_assert_throws(doc.root()["list"][1], ParseException);
+  });
+
+  it("should reject binary documents whose containers share children", [] {
+    // 30 arrays, each holding the next one twice, would decode to 2^30 values
+    std::string bytes("JSNB", 4);
+    auto put_u32 = [&bytes](std::uint32_t val) { bytes.append(reinterpret_cast<const char*>(&val), 4); };
+    const std::uint32_t depth = 30, size = 16 + depth * 13 + 1;
+    put_u32(1);
+    put_u32(size);
+    put_u32(16);
+    for (std::uint32_t i = 0; i < depth; ++i) {
+      bytes += static_cast<char>(detail::BinaryTag::Array);
+      put_u32(2);
+      put_u32(16 + (i + 1) * 13);
+      put_u32(16 + (i + 1) * 13);
+    }
+    bytes += static_cast<char>(detail::BinaryTag::Null);
+
+    BinaryDocument doc;
+    ut_assert(doc.parse(bytes));
+    ut_assert(doc.root()[1][0][1].is<Array>());
+    ut_assert_throws(doc.root().to_value(), ParseException);
+  });
+
+  it("should map struct fields in both directions", [] {
+    Person person;
+    person.name = "Ada \"A\"";
+    person.age = 36;
+    person.tags = {"math", "engines"};
+    person.address.city = "London";
+    person.address.zip = 1815;
+    person.previous.resize(1);
+    person.previous[0].city = "Marylebone";
+    person.previous[0].zip = 1;
+
+    std::string text;
+    {
+      OutStream out(text);
+      format(out, person);
+    }
+    ut_assert_eq(text, R"({"name":"Ada \"A\"","age":36,"active":true,"tags":["math","engines"],)"
+                       R"("address":{"city":"London","zip":1815},"previous":[{"city":"Marylebone","zip":1}]})");
+
+    Person copy;
+    InStream in(text);
+    format(in, copy);
+    ut_assert(in);
+    ut_assert_eq(copy.name, person.name);
+    ut_assert_eq(copy.tags.size(), 2);
+    ut_assert_eq(copy.address.zip, 1815);
+    ut_assert_eq(copy.previous[0].city, "Marylebone");
+
+    // members in any order, unknown ones skipped, missing ones left at their defaults
+    Person other;
+    other.age = 7;
+    InStream shuffled(R"({ "extra": {"name": "not me", "list": ["]", "}"]}, "address": {"zip": 2, "unknown": [1, {}]},
+                          "n\u0061me": "escaped", "note": "a \" quote", "skip": -1.5e3, "tags": ["x"], "flag": null })");
+    format(shuffled, other);
+    ut_assert(shuffled);
+    ut_assert_eq(other.name, "escaped");
+    ut_assert_eq(other.age, 7);
+    ut_assert(other.active);
+    ut_assert_eq(other.address.zip, 2);
+    ut_assert_eq(other.address.city, "");
+    ut_assert_eq(other.tags.size(), 1);
+
+    // present members replace the field rather than appending to it
+    InStream again(R"({"name": "replaced", "tags": ["y"]})");
+    format(again, other);
+    ut_assert_eq(other.name, "replaced");
+    ut_assert_eq(other.tags.size(), 1);
+    ut_assert_eq(other.tags[0], "y");
+
+    std::istringstream stream(R"({"address": {"city": "Paris"}, "unknown": {"a": [1, 2]}, "age": 40})");
+    InStream streamed(stream);
+    format(streamed, other);
+    ut_assert(streamed);
+    ut_assert_eq(other.address.city, "Paris");
+    ut_assert_eq(other.age, 40);
+
+    Person broken;
+    InStream bad(R"({"name": "x", "age": })");
+    format(bad, broken);
+    ut_assert(!bad);
+  });
+
   it("should fail to parse a json string", [] {
     constexpr const char* input = R"(
       {"Hello",: [1,2,3],
@@ -347,10 +1305,8 @@ describe(suite)
   /*
   it("should parse a very large json object", []{
     for (std::size_t i = 0; i < 10; ++i) {
-      const auto& str = get_file_contents("stress.json");
-      InStream ssi(str);
-      Value fill;
-      format(ssi, fill);
+      Document doc;
+      doc.open("stress.json");
     }
 
     //std::cout << fill << std::endl;
@@ -0,0 +1,212 @@
+#include <uber_test.hpp>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <serializer/msgpack/value.h>
+
+using namespace ut;
+
+// encodes obj and returns the bytes as lowercase hex
+template <typename T>
+std::string hex(const T& obj) {
+  std::string bytes;
+  {
+    msgpack::OutStream out(bytes);
+    format(out, obj);
+  }
+
+  static const char digits[] = "0123456789abcdef";
+  std::string res;
+  for (unsigned char c : bytes) {
+    res += digits[c >> 4];
+    res += digits[c & 15];
+  }
+  return res;
+}
+
+template <typename T>
+std::string encode(const T& obj) {
+  std::string bytes;
+  msgpack::OutStream out(bytes);
+  format(out, obj);
+  out.flush();
+  return bytes;
+}
+
+template <typename T>
+bool decode(const std::string& bytes, T& obj) {
+  msgpack::InStream in(bytes);
+  format(in, obj);
+  return in && in.remaining() == 0;
+}
+
+describe(suite)
+  it("should encode scalars in their shortest form", []{
+    ut_assert_eq(hex(0), "00");
+    ut_assert_eq(hex(127), "7f");
+    ut_assert_eq(hex(-1), "ff");
+    ut_assert_eq(hex(-32), "e0");
+    ut_assert_eq(hex(-33), "d0df");
+    ut_assert_eq(hex(200), "ccc8");
+    ut_assert_eq(hex(-200), "d1ff38");
+    ut_assert_eq(hex(70000u), "ce00011170");
+    ut_assert_eq(hex(std::int64_t(-5000000000)), "d3fffffffed5fa0e00");
+    ut_assert_eq(hex(true), "c3");
+    ut_assert_eq(hex(false), "c2");
+    ut_assert_eq(hex(std::string("hi")), "a26869");
+    ut_assert_eq(hex(std::string(32, 'x')).substr(0, 4), "d920");
+    ut_assert_eq(hex(json::Null()), "c0");
+  });
+
+  it("should encode doubles as integers or float32 when that is exact", []{
+    ut_assert_eq(hex(3.0), "03");
+    ut_assert_eq(hex(-300.0), "d1fed4");
+    ut_assert_eq(hex(1.5), "ca3fc00000");
+    ut_assert_eq(hex(0.1), "cb3fb999999999999a");
+    ut_assert_eq(hex(-0.0), "ca80000000");
+    ut_assert_eq(hex(1e300), "cb7e37e43c8800759c");
+  });
+
+  it("should round trip standard containers", []{
+    std::map<std::string, std::vector<int>> map = {{"a", {1, 2, 3}}, {"b", {}}, {"c", {-70000}}};
+    std::map<std::string, std::vector<int>> map2;
+    ut_assert(decode(encode(map), map2));
+    ut_assert(map == map2);
+
+    std::unordered_map<std::string, std::string> strs = {{"hello", "world"}, {"long", std::string(70000, 'z')}};
+    std::unordered_map<std::string, std::string> strs2;
+    ut_assert(decode(encode(strs), strs2));
+    ut_assert(strs == strs2);
+
+    std::list<double> nums;
+    for (int i = 0; i < 100; ++i)
+      nums.push_back(i * 0.37 - 10);
+    std::list<double> nums2;
+    ut_assert_eq(hex(nums).substr(0, 6), "dc0064");
+    ut_assert(decode(encode(nums), nums2));
+    ut_assert(nums == nums2);
+
+    std::vector<std::vector<std::string>> nested = {{"x"}, {}, {"y", "z"}};
+    std::vector<std::vector<std::string>> nested2;
+    ut_assert(decode(encode(nested), nested2));
+    ut_assert(nested == nested2);
+  });
+
+  it("should round trip json values", []{
+    json::Value v;
+    v.parse(R"({
+      "name": "example",
+      "count": 42,
+      "ratio": 0.25,
+      "precise": 0.1,
+      "negative": -123456789012,
+      "flags": [true, false, null],
+      "nested": {"empty": {}, "list": [], "text": "café \"quoted\""}
+    })");
+
+    json::Value v2;
+    auto bytes = encode(v);
+    ut_assert(decode(bytes, v2));
+    ut_assert_eq(v, v2);
+    ut_assert_eq(v2["nested"]["text"].as<json::String>(), "caf\xc3\xa9 \"quoted\"");
+    ut_assert_eq(v2["negative"].as<json::Number>(), -123456789012.0);
+    ut_assert(bytes.size() < v.json().size());
+
+    // members keep their order
+    std::vector<std::string> keys;
+    for (const auto& member : v2.as<json::Object>())
+      keys.push_back(member.first);
+    ut_assert_eq(keys.front(), "name");
+    ut_assert_eq(keys.back(), "nested");
+  });
+
+  it("should read json values inside standard containers", []{
+    std::map<std::string, json::Value> map = {{"a", json::Object{{"b", json::Array{1, "two"}}}}, {"c", nullptr}};
+    std::map<std::string, json::Value> map2;
+    ut_assert(decode(encode(map), map2));
+    ut_assert_eq(map2.size(), 2);
+    ut_assert_eq(map2["a"]["b"][1].as<json::String>(), "two");
+    ut_assert(map2["c"].is<json::Null>());
+  });
+
+  it("should convert numbers only when they fit", []{
+    std::uint8_t small;
+    ut_assert(!decode(encode(300), small));
+    ut_assert(decode(encode(255), small));
+    ut_assert_eq(small, 255);
+
+    unsigned positive;
+    ut_assert(!decode(encode(-1), positive));
+
+    int whole;
+    ut_assert(!decode(encode(2.5), whole));
+    ut_assert(decode(encode(-2.0), whole));
+    ut_assert_eq(whole, -2);
+
+    double real;
+    ut_assert(decode(encode(std::uint64_t(1) << 40), real));
+    ut_assert_eq(real, 1099511627776.0);
+
+    std::string str;
+    ut_assert(!decode(encode(1), str));
+  });
+
+  it("should reject truncated and unsupported input", []{
+    auto bytes = encode(std::vector<std::string>{"abc", "def"});
+    for (std::size_t len = 0; len < bytes.size(); ++len) {
+      std::vector<std::string> res;
+      ut_assert(!decode(bytes.substr(0, len), res));
+    }
+
+    json::Value v;
+    ut_assert(!decode(std::string("\xd4\x01\x00", 3), v));
+
+    // a header claiming more elements than there are bytes
+    ut_assert(!decode(std::string("\xdd\xff\xff\xff\xff\x01", 6), v));
+
+    // and so on at every level
+    std::string nested;
+    for (int i = 0; i < 200; ++i)
+      nested += std::string("\xdd\xff\xff\xff\xff", 5);
+    ut_assert(!decode(nested, v));
+  });
+
+  it("should write to and read from std streams", []{
+    json::Value v = json::Object{{"list", json::Array{1, 2, 3}}, {"name", "streamed"}};
+
+    std::ostringstream os;
+    {
+      msgpack::OutStream out(os);
+      format(out, v);
+    }
+
+    std::istringstream is(os.str());
+    msgpack::InStream in(is);
+    json::Value v2;
+    format(in, v2);
+    ut_assert(in);
+    ut_assert_eq(v, v2);
+    ut_assert_eq(in.peek(), std::char_traits<char>::eof());
+
+    // a string or key whose header claims 4GB, with no bytes behind it
+    std::istringstream str32(std::string("\xdb\xff\xff\xff\xff", 5));
+    msgpack::InStream truncated(str32);
+    format(truncated, v2);
+    ut_assert(!truncated);
+
+    std::istringstream key32(std::string("\x81\xdb\xff\xff\xff\xff", 6));
+    msgpack::InStream truncated_key(key32);
+    format(truncated_key, v2);
+    ut_assert(!truncated_key);
+  });
+done(suite)
+
+int main(int argc, char* argv[]) {
+  OstreamReporter rep(std::cout);
+  Registry::get("root")->execute(rep);
+}